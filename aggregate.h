@@ -0,0 +1,144 @@
+/***************************************/
+/* Aggregates over encrypted columns   */
+/* Total sum, dot product, mean and    */
+/* sliding-window sum built from slot  */
+/* rotations, with either of two       */
+/* rotation-key sets:                  */
+/*   log-step   powers of two, about   */
+/*              log2(width) keys       */
+/*   bsgs       baby steps 1..b-1 and  */
+/*              giant steps of b,      */
+/*              about 2 sqrt(width)    */
+/*              keys; the baby steps,  */
+/*              then the giant steps,  */
+/*              rotate one ciphertext  */
+/*              and are hoisted        */
+/*                                     */
+/* Rotations cycle within a row of     */
+/* rowSize() slots, so with two-row    */
+/* BFV/BGV batching every aggregate is */
+/* per row.                            */
+/***************************************/
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "he_backend.h"
+#include "keys.h"
+
+enum class RotationPlan { LogStep, BabyGiant };
+
+inline std::string describePlan(RotationPlan plan)
+{
+	return plan == RotationPlan::LogStep ? "log-step" : "bsgs";
+}
+
+//Rotations past half a row use the key for the shorter way round
+inline CipherPtr rotateInRow(HEBackend &he, const CipherPtr &c, size_t steps)
+{
+	return he.rotate(c, normalizeRotation((long)steps, he.rowSize()));
+}
+
+//Rotations by first, first + stride, ... (count of them), hoisted
+inline std::vector<CipherPtr> rotateManyInRow(HEBackend &he, const CipherPtr &c, size_t first, size_t stride,
+	size_t count)
+{
+	std::vector<int> steps;
+	for (size_t i = 0; i < count; i++)
+		steps.push_back(normalizeRotation((long)(first + i * stride), he.rowSize()));
+	return he.rotateMany(c, steps);
+}
+
+//Slot j receives the sum of slots j .. j+width-1 of its row, cyclically
+inline CipherPtr windowSum(HEBackend &he, const CipherPtr &c, size_t width, RotationPlan plan)
+{
+	if (width == 0 || width > he.rowSize())
+		throw std::invalid_argument("window of " + std::to_string(width) + " slots in rows of "
+			+ std::to_string(he.rowSize()));
+
+	if (plan == RotationPlan::LogStep)
+	{
+		//run sums k neighbours, doubling each step; each set bit of width adds
+		//run shifted past the neighbours already covered
+		CipherPtr acc, run = c;
+		size_t covered = 0;
+		for (size_t k = 1;; k <<= 1)
+		{
+			if (width & k)
+			{
+				CipherPtr part = covered ? rotateInRow(he, run, covered) : run;
+				acc = acc ? he.add(acc, part) : part;
+				covered += k;
+			}
+			if (covered == width)
+				return acc;
+			run = he.add(run, rotateInRow(he, run, k));
+		}
+	}
+
+	//width = giant * baby + rest; the rest is a prefix of the baby-step sum
+	size_t baby = (size_t)std::ceil(std::sqrt((double)width));
+	size_t giant = width / baby, rest = width % baby;
+	std::vector<CipherPtr> babies = rotateManyInRow(he, c, 1, 1, baby - 1);
+	CipherPtr inner = c, prefix;
+	for (size_t i = 1; i < baby; i++)
+	{
+		if (i == rest)
+			prefix = inner;
+		inner = he.add(inner, babies[i - 1]);
+	}
+	std::vector<CipherPtr> giants = rotateManyInRow(he, inner, baby, baby, giant - 1);
+	CipherPtr acc = inner;
+	for (size_t j = 0; j < giants.size(); j++)
+		acc = he.add(acc, giants[j]);
+	if (rest)
+		acc = he.add(acc, rotateInRow(he, prefix, giant * baby));
+	return acc;
+}
+
+//Every slot of a row receives the row's total
+inline CipherPtr totalSum(HEBackend &he, const CipherPtr &c, RotationPlan plan)
+{
+	return windowSum(he, c, he.rowSize(), plan);
+}
+
+inline CipherPtr dotProduct(HEBackend &he, const CipherPtr &a, const CipherPtr &b, RotationPlan plan)
+{
+	CipherPtr p = he.multiply(a, b);
+	he.relinearize(p);
+	he.rescale(p);
+	return totalSum(he, p, plan);
+}
+
+//CKKS: the total times 1/count. Integer schemes cannot divide, so they return
+//the total and the caller divides after decryption.
+inline CipherPtr mean(HEBackend &he, const CipherPtr &c, size_t count, RotationPlan plan)
+{
+	CipherPtr total = totalSum(he, c, plan);
+	if (he.scheme() != Scheme::CKKS)
+		return total;
+	CipherPtr m = he.multiplyPlain(total, he.encode(std::vector<double>(he.slotCount(), 1.0 / count)));
+	he.rescale(m);
+	return m;
+}
+
+//windowSum on a plaintext column laid out over slots in rows of rowSize
+inline std::vector<double> referenceWindow(const std::vector<double> &values, size_t slots, size_t rowSize,
+	size_t width)
+{
+	std::vector<double> padded(slots, 0), out(slots, 0);
+	for (size_t i = 0; i < values.size() && i < slots; i++)
+		padded[i] = values[i];
+	for (size_t j = 0; j < slots; j++)
+	{
+		size_t row = j / rowSize * rowSize, col = j % rowSize;
+		for (size_t i = 0; i < width; i++)
+			out[j] += padded[row + (col + i) % rowSize];
+	}
+	return out;
+}
+
+#endif
@@ -0,0 +1,83 @@
+/***************************************/
+/* Global allocation hook              */
+/* Interposes malloc and friends on    */
+/* glibc so that every allocation,     */
+/* including SEAL's pool, PALISADE and */
+/* NTL inside HElib, is counted in     */
+/* heap_counters (memory.h).           */
+/*                                     */
+/* Linked into every program when      */
+/* HE_COUNT_ALLOCATIONS is on.         */
+/***************************************/
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include "memory.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+
+extern "C"
+{
+	void *__libc_malloc(size_t size);
+	void *__libc_calloc(size_t count, size_t size);
+	void *__libc_realloc(void *ptr, size_t size);
+	void *__libc_memalign(size_t alignment, size_t size);
+	void __libc_free(void *ptr);
+
+	static void *counted(void *p)
+	{
+		if (p)
+			countAllocation(malloc_usable_size(p));
+		return p;
+	}
+
+	void *malloc(size_t size)
+	{
+		return counted(__libc_malloc(size));
+	}
+
+	void *calloc(size_t count, size_t size)
+	{
+		return counted(__libc_calloc(count, size));
+	}
+
+	void free(void *ptr)
+	{
+		if (ptr)
+			countRelease(malloc_usable_size(ptr));
+		__libc_free(ptr);
+	}
+
+	void *realloc(void *ptr, size_t size)
+	{
+		size_t old = ptr ? malloc_usable_size(ptr) : 0;
+		void *p = __libc_realloc(ptr, size);
+		//realloc(ptr, 0) frees ptr; any other failure leaves it allocated
+		if (p || !size)
+			countRelease(old);
+		return counted(p);
+	}
+
+	void *memalign(size_t alignment, size_t size)
+	{
+		return counted(__libc_memalign(alignment, size));
+	}
+
+	void *aligned_alloc(size_t alignment, size_t size)
+	{
+		return counted(__libc_memalign(alignment, size));
+	}
+
+	int posix_memalign(void **out, size_t alignment, size_t size)
+	{
+		if (alignment % sizeof(void *) || (alignment & (alignment - 1)))
+			return EINVAL;
+		void *p = counted(__libc_memalign(alignment, size));
+		if (!p && size)
+			return ENOMEM;
+		*out = p;
+		return 0;
+	}
+}
+#endif
@@ -0,0 +1,284 @@
+/***************************************/
+/* Asynchronous evaluation             */
+/* Every call returns an Async handle  */
+/* at once; a node runs on the pool as */
+/* soon as the handles it takes are    */
+/* ready, so the stages of different   */
+/* chunks overlap across cores instead */
+/* of running phase by phase. A failed */
+/* node fails everything after it with */
+/* the same exception.                 */
+/***************************************/
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "he_backend.h"
+#include "parallel.h"
+#include "thread_pool.h"
+#include "workload.h"
+
+//Completion and the callbacks waiting for it, shared by every Async<T>
+struct AsyncNode
+{
+	AsyncNode() : done(false) {}
+
+	//Runs k at once when already complete, otherwise on the completing thread
+	void onDone(std::function<void()> k)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!done)
+			{
+				waiters.push_back(std::move(k));
+				return;
+			}
+		}
+		k();
+	}
+
+	void finish(std::exception_ptr e)
+	{
+		std::vector<std::function<void()>> run;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done = true;
+			error = e;
+			run.swap(waiters);
+		}
+		ready.notify_all();
+		for (size_t i = 0; i < run.size(); i++)
+			run[i]();
+	}
+
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		ready.wait(lock, [this] { return done; });
+	}
+
+	std::mutex mutex;
+	std::condition_variable ready;
+	bool done;
+	std::exception_ptr error;
+	std::vector<std::function<void()>> waiters;
+};
+
+template <class T>
+struct AsyncState : AsyncNode
+{
+	T value;
+};
+
+//A value some node of a TaskGraph will produce
+template <class T>
+class Async
+{
+public:
+	Async() {}
+	explicit Async(std::shared_ptr<AsyncState<T>> state) : state(std::move(state)) {}
+
+	bool valid() const { return (bool)state; }
+	bool ready() const
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		return state->done;
+	}
+
+	//Blocks until the value is ready and rethrows a failure. Nodes receive
+	//their inputs as arguments, so call this from outside the pool only.
+	const T &get() const
+	{
+		state->wait();
+		if (state->error)
+			std::rethrow_exception(state->error);
+		return state->value;
+	}
+
+	std::shared_ptr<AsyncState<T>> state;
+};
+
+//Schedules nodes on a ThreadPool as their inputs complete
+class TaskGraph
+{
+public:
+	explicit TaskGraph(ThreadPool &pool) : pool(pool) {}
+
+	template <class T>
+	static Async<T> ready(T value)
+	{
+		std::shared_ptr<AsyncState<T>> s(new AsyncState<T>);
+		s->value = std::move(value);
+		s->finish(std::exception_ptr());
+		return Async<T>(s);
+	}
+
+	//f(a.get(), b.get(), ...) once every input is ready, at once without
+	//inputs; f must return a value
+	template <class F, class... A>
+	auto after(F f, const Async<A> &... in) -> Async<decltype(f(std::declval<const A &>()...))>
+	{
+		typedef decltype(f(std::declval<const A &>()...)) R;
+		std::shared_ptr<AsyncState<R>> out(new AsyncState<R>);
+		//one count per input plus one released below, after every callback is registered
+		std::shared_ptr<std::atomic<size_t>> remaining(new std::atomic<size_t>(sizeof...(A) + 1));
+		ThreadPool *p = &pool;
+		std::function<void()> launch = [=] {
+			if (--*remaining != 0)
+				return;
+			p->post([=] {
+				std::exception_ptr failed = firstError({ in.state.get()... });
+				if (!failed)
+					try
+					{
+						out->value = f(in.state->value...);
+					}
+					catch (...)
+					{
+						failed = std::current_exception();
+					}
+				out->finish(failed);
+			});
+		};
+		int expand[] = { 0, (in.state->onDone(launch), 0)... };
+		(void)expand;
+		launch();
+		return Async<R>(out);
+	}
+
+private:
+	static std::exception_ptr firstError(std::initializer_list<AsyncNode *> nodes)
+	{
+		for (AsyncNode *n : nodes)
+			if (n->error)
+				return n->error;
+		return std::exception_ptr();
+	}
+
+	ThreadPool &pool;
+};
+
+//HEBackend with every call returning at once. The backend is used from
+//several pool threads at once, as in parallel.h; values passed to encode
+//must outlive the node.
+class AsyncBackend
+{
+public:
+	AsyncBackend(HEBackend &he, ThreadPool &pool) : he(he), graph(pool) {}
+
+	Async<PlainPtr> encode(ColumnSpan values)
+	{
+		HEBackend *b = &he;
+		return graph.after([b, values] { return b->encode(values); });
+	}
+
+	Async<CipherPtr> encrypt(const Async<PlainPtr> &p)
+	{
+		HEBackend *b = &he;
+		return graph.after([b](const PlainPtr &plain) { return b->encrypt(plain); }, p);
+	}
+
+	Async<PlainPtr> decrypt(const Async<CipherPtr> &c)
+	{
+		HEBackend *b = &he;
+		return graph.after([b](const CipherPtr &cipher) { return b->decrypt(cipher); }, c);
+	}
+
+	Async<std::vector<double>> decode(const Async<PlainPtr> &p)
+	{
+		HEBackend *b = &he;
+		return graph.after([b](const PlainPtr &plain) { return b->decode(plain); }, p);
+	}
+
+	Async<CipherPtr> add(const Async<CipherPtr> &a, const Async<CipherPtr> &c)
+	{
+		return evaluate([](HEBackend &b, const CipherPtr &x, const CipherPtr &y) { return b.add(x, y); }, a, c);
+	}
+
+	//Product, relinearized and rescaled as evalYXZ does
+	Async<CipherPtr> multiply(const Async<CipherPtr> &a, const Async<CipherPtr> &c)
+	{
+		return evaluate([](HEBackend &b, const CipherPtr &x, const CipherPtr &y) {
+			CipherPtr p = b.multiply(x, y);
+			b.relinearize(p);
+			b.rescale(p);
+			return p;
+		}, a, c);
+	}
+
+	//f(backend, inputs...) as one node, e.g. a whole circuit. Inputs may be
+	//shared with other nodes, so f must not modify them in place.
+	template <class F, class... A>
+	Async<CipherPtr> evaluate(F f, const Async<A> &... in)
+	{
+		HEBackend *b = &he;
+		return graph.after([b, f](const A &... v) { return f(*b, v...); }, in...);
+	}
+
+	TaskGraph &tasks() { return graph; }
+
+private:
+	HEBackend &he;
+	TaskGraph graph;
+};
+
+//y(x+z) over every chunk as one graph: the stages of up to inflight chunks
+//overlap on the pool, and the oldest chunk is awaited before another starts.
+//The context and keys must already exist.
+inline std::vector<double> runAsyncYXZ(HEBackend &he, ThreadPool &pool, const Columns &cols, size_t inflight)
+{
+	size_t rows = cols.x.size();
+	size_t slots = he.slotCount();
+	size_t chunks = (rows + slots - 1) / slots;
+	std::vector<double> out(rows);
+	AsyncBackend async(he, pool);
+
+	//every node of a chunk completes before its last one, so once the window
+	//is drained nothing still reads cols or writes out
+	std::deque<Async<size_t>> window;
+	std::exception_ptr failed;
+	auto retire = [&] {
+		try
+		{
+			window.front().get();
+		}
+		catch (...)
+		{
+			if (!failed)
+				failed = std::current_exception();
+		}
+		window.pop_front();
+	};
+	for (size_t i = 0; i < chunks && !failed; i++)
+	{
+		size_t offset = i * slots, n = std::min(slots, rows - offset);
+		Async<CipherPtr> x = async.encrypt(async.encode(sliceColumn(cols.x, offset, slots)));
+		Async<CipherPtr> y = async.encrypt(async.encode(sliceColumn(cols.y, offset, slots)));
+		Async<CipherPtr> z = async.encrypt(async.encode(sliceColumn(cols.z, offset, slots)));
+		Async<CipherPtr> e = async.evaluate(evalYXZ, x, y, z);
+		double *dest = out.data() + offset;
+		window.push_back(async.tasks().after([dest, n](const std::vector<double> &v) {
+			std::copy(v.begin(), v.begin() + std::min(n, v.size()), dest);
+			return n;
+		}, async.decode(async.decrypt(e))));
+
+		if (window.size() >= std::max<size_t>(inflight, 1))
+			retire();
+	}
+	while (!window.empty())
+		retire();
+	if (failed)
+		std::rethrow_exception(failed);
+	return out;
+}
+
+#endif
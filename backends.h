@@ -0,0 +1,68 @@
+/***************************************/
+/* Backend registry                    */
+/* Adapters are compiled in when the   */
+/* build defines HE_WITH_SEAL,         */
+/* HE_WITH_PALISADE or HE_WITH_HELIB.  */
+/***************************************/
+#ifndef BACKENDS_H
+#define BACKENDS_H
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "he_backend.h"
+
+#ifdef HE_WITH_SEAL
+#include "seal_backend.h"
+#endif
+#ifdef HE_WITH_PALISADE
+#include "palisade_backend.h"
+#endif
+#ifdef HE_WITH_HELIB
+#include "helib_backend.h"
+#endif
+
+//Names of the backends available in this build
+inline std::vector<std::string> availableBackends()
+{
+	std::vector<std::string> names;
+#ifdef HE_WITH_SEAL
+	names.push_back("seal-bfv");
+	names.push_back("seal-ckks");
+#endif
+#ifdef HE_WITH_PALISADE
+	names.push_back("palisade-bfv");
+	names.push_back("palisade-bgv");
+	names.push_back("palisade-ckks");
+#endif
+#ifdef HE_WITH_HELIB
+	names.push_back("helib-bgv");
+#endif
+	return names;
+}
+
+inline std::unique_ptr<HEBackend> makeBackend(const std::string &name)
+{
+#ifdef HE_WITH_SEAL
+	if (name == "seal-bfv")
+		return std::unique_ptr<HEBackend>(new SealBackend(Scheme::BFV));
+	if (name == "seal-ckks")
+		return std::unique_ptr<HEBackend>(new SealBackend(Scheme::CKKS));
+#endif
+#ifdef HE_WITH_PALISADE
+	if (name == "palisade-bfv")
+		return std::unique_ptr<HEBackend>(new PalisadeBackend(Scheme::BFV));
+	if (name == "palisade-bgv")
+		return std::unique_ptr<HEBackend>(new PalisadeBackend(Scheme::BGV));
+	if (name == "palisade-ckks")
+		return std::unique_ptr<HEBackend>(new PalisadeBackend(Scheme::CKKS));
+#endif
+#ifdef HE_WITH_HELIB
+	if (name == "helib-bgv")
+		return std::unique_ptr<HEBackend>(new HelibBackend(Scheme::BGV));
+#endif
+	throw std::invalid_argument("backend '" + name + "' is not available in this build");
+}
+
+#endif
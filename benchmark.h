@@ -0,0 +1,460 @@
+/***************************************/
+/* Benchmark harness                   */
+/* Wall and CPU time per phase over    */
+/* warm-up runs and N repetitions,     */
+/* summarised as min/median/p95/p99    */
+/* and written as JSON or CSV, with    */
+/* peak RSS, heap and pool use per     */
+/* phase and object sizes alongside.   */
+/*                                     */
+/* Options: --warmup N  --reps N       */
+/*          --json FILE --csv FILE     */
+/*          --trace FILE (HE_TRACE)    */
+/***************************************/
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "memory.h"
+#include "options.h"
+#include "trace.h"
+
+struct PhaseSample
+{
+	double wall;    //seconds, steady clock
+	double cpu;     //seconds, process CPU time summed over all threads
+};
+
+//Wall and CPU time since construction, for code timed outside a Benchmark
+class Stopwatch
+{
+public:
+	Stopwatch() : wall(std::chrono::steady_clock::now()), cpu(std::clock()) {}
+
+	PhaseSample elapsed() const
+	{
+		PhaseSample s;
+		s.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall).count();
+		s.cpu = double(std::clock() - cpu) / CLOCKS_PER_SEC;
+		return s;
+	}
+
+private:
+	std::chrono::steady_clock::time_point wall;
+	std::clock_t cpu;
+};
+
+struct Summary
+{
+	double min, median, p95, p99, mean;
+};
+
+//nearest-rank percentile of an already sorted sample
+inline double percentile(const std::vector<double> &sorted, double p)
+{
+	if (sorted.empty())
+		return 0;
+	size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.999999);
+	if (rank < 1)
+		rank = 1;
+	if (rank > sorted.size())
+		rank = sorted.size();
+	return sorted[rank - 1];
+}
+
+inline Summary summarize(std::vector<double> v)
+{
+	Summary s = { 0, 0, 0, 0, 0 };
+	if (v.empty())
+		return s;
+
+	std::sort(v.begin(), v.end());
+	s.min = v.front();
+	s.median = v.size() % 2 ? v[v.size() / 2] : (v[v.size() / 2 - 1] + v[v.size() / 2]) / 2;
+	s.p95 = percentile(v, 95);
+	s.p99 = percentile(v, 99);
+	for (size_t i = 0; i < v.size(); i++)
+		s.mean += v[i];
+	s.mean /= v.size();
+	return s;
+}
+
+class Benchmark
+{
+public:
+	Benchmark(const std::string &name, int argc, char **argv)
+		: name(name), run_index(-1)
+	{
+		Options opts(argc, argv);
+		warmup = (int)opts.getInt("warmup", 1);
+		reps = (int)opts.getInt("reps", 5);
+		json_path = opts.get("json");
+		csv_path = opts.get("csv");
+		trace_path = opts.get("trace");
+		if (!trace_path.empty())
+			traceOpen(trace_path);
+		if (warmup < 0)
+			warmup = 0;
+		if (reps < 1)
+			reps = 1;
+	}
+
+	//Advance to the next run; false once warm-ups and repetitions are done.
+	//Usage: while (bench.next()) { bench.start("keygen"); ... bench.stop("keygen"); }
+	bool next()
+	{
+		run_index++;
+		if (run_index < warmup + reps)
+			return true;
+		finish();
+		return false;
+	}
+
+	//Override --json/--csv, e.g. when one process benchmarks several backends
+	void output(const std::string &json, const std::string &csv)
+	{
+		json_path = json;
+		csv_path = csv;
+	}
+
+	bool warmingUp() const { return run_index < warmup; }
+	bool last() const { return run_index == warmup + reps - 1; }
+	int repetitions() const { return reps; }
+
+	//Bytes held by a library's own memory pool, e.g.
+	//[] { return seal::MemoryManager::GetPool().alloc_byte_count(); }
+	void poolProbe(const std::function<size_t()> &probe) { pool_probe = probe; }
+
+	//In-memory size of a key or ciphertext object, reported with the phases
+	void objectSize(const std::string &object, size_t bytes)
+	{
+		for (size_t i = 0; i < objects.size(); i++)
+			if (objects[i].first == object)
+			{
+				objects[i].second = bytes;
+				return;
+			}
+		objects.push_back(std::make_pair(object, bytes));
+	}
+
+	void start(const std::string &phase)
+	{
+		Clock &c = open[phase];
+		c.memory.start(pool_probe);
+		c.cpu = std::clock();
+		c.wall = std::chrono::steady_clock::now();
+	}
+
+	void stop(const std::string &phase)
+	{
+		std::chrono::steady_clock::time_point wall_end = std::chrono::steady_clock::now();
+		std::clock_t cpu_end = std::clock();
+
+		std::map<std::string, Clock>::iterator it = open.find(phase);
+		if (it == open.end())
+			return;
+
+		PhaseSample s;
+		s.wall = std::chrono::duration<double>(wall_end - it->second.wall).count();
+		s.cpu = double(cpu_end - it->second.cpu) / CLOCKS_PER_SEC;
+		MemorySample m = it->second.memory.stop(pool_probe);
+		HE_TRACE_SPAN(name + ": " + phase, "phase", it->second.wall, wall_end);
+		open.erase(it);
+		record(phase, s);
+		if (!warmingUp())
+			memory[phase].push_back(m);
+	}
+
+	//Add a sample measured elsewhere; warm-up samples are discarded.
+	void record(const std::string &phase, const PhaseSample &s)
+	{
+		if (warmingUp())
+			return;
+		if (samples.find(phase) == samples.end())
+			order.push_back(phase);
+		samples[phase].push_back(s);
+	}
+
+	const std::string &title() const { return name; }
+	const std::vector<std::string> &phases() const { return order; }
+
+	Summary summary(const std::string &phase, bool cpu = false) const
+	{
+		return summarize(column(phase, cpu));
+	}
+
+	void report(std::ostream &out) const
+	{
+		out << std::endl << "Times for " << name << " (" << reps << " runs after " << warmup
+			<< " warm-up, seconds):" << std::endl;
+		out << std::left << std::setw(14) << "phase" << std::setw(6) << "clock" << std::right
+			<< std::setw(12) << "min" << std::setw(12) << "median" << std::setw(12) << "p95"
+			<< std::setw(12) << "p99" << std::endl;
+
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			Summary w = summarize(column(order[i], false));
+			Summary c = summarize(column(order[i], true));
+			printRow(out, order[i], "wall", w);
+			printRow(out, "", "cpu", c);
+		}
+		if (memory.empty() && objects.empty())
+			return;
+
+		out << std::endl << "Memory for " << name << " (median per run, MB):" << std::endl;
+		out << std::left << std::setw(14) << "phase" << std::right << std::setw(12) << "peak RSS"
+			<< std::setw(12) << "heap peak" << std::setw(12) << "allocated" << std::setw(12) << "allocs"
+			<< std::setw(12) << "pool" << std::endl;
+		const double mb = 1.0 / (1024 * 1024);
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			if (!memory.count(order[i]))
+				continue;
+			out << std::left << std::setw(14) << order[i] << std::right << std::fixed;
+			for (int f = 0; f < MemoryFields; f++)
+			{
+				double v = summarize(memoryColumn(order[i], f)).median;
+				if (f == 3)
+					out << std::setprecision(0) << std::setw(12) << v;
+				else
+					out << std::setprecision(2) << std::setw(12) << v * mb;
+			}
+			out << std::endl;
+			out.unsetf(std::ios::fixed);
+		}
+		if (!heapCounting())
+			out << "(heap columns need a build with HE_COUNT_ALLOCATIONS)" << std::endl;
+		if (!trace_path.empty() && !TraceBuilt)
+			out << "(--trace needs a build with HE_TRACE)" << std::endl;
+		for (size_t i = 0; i < objects.size(); i++)
+			out << std::left << std::setw(26) << objects[i].first << std::right << std::setw(12)
+				<< objects[i].second << " bytes" << std::endl;
+	}
+
+	void writeJson(std::ostream &out) const
+	{
+		out << std::setprecision(9);
+		out << "{\n  \"program\": \"" << name << "\",\n  \"warmup\": " << warmup
+			<< ",\n  \"reps\": " << reps << ",\n  \"phases\": [";
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			const std::vector<PhaseSample> &v = samples.find(order[i])->second;
+			out << (i ? "," : "") << "\n    { \"phase\": \"" << order[i] << "\"";
+			jsonSummary(out, "wall", summarize(column(order[i], false)));
+			jsonSummary(out, "cpu", summarize(column(order[i], true)));
+			out << ", \"samples\": [";
+			for (size_t j = 0; j < v.size(); j++)
+				out << (j ? ", " : "") << "[" << v[j].wall << ", " << v[j].cpu << "]";
+			out << "]";
+			if (memory.count(order[i]))
+			{
+				out << ", \"memory\": {";
+				for (int f = 0; f < MemoryFields; f++)
+					out << (f ? ", " : " ") << "\"" << memoryField(f) << "\": "
+						<< summarize(memoryColumn(order[i], f)).median;
+				out << " }";
+			}
+			out << " }";
+		}
+		out << "\n  ],\n  \"objects\": [";
+		for (size_t i = 0; i < objects.size(); i++)
+			out << (i ? "," : "") << "\n    { \"object\": \"" << objects[i].first << "\", \"bytes\": "
+				<< objects[i].second << " }";
+		out << (objects.empty() ? "" : "\n  ") << "]\n}\n";
+	}
+
+	void writeCsv(std::ostream &out) const
+	{
+		out << std::setprecision(9);
+		out << "program,phase,clock,min,median,p95,p99,mean\n";
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			csvRow(out, order[i], "wall", summarize(column(order[i], false)));
+			csvRow(out, order[i], "cpu", summarize(column(order[i], true)));
+			if (memory.count(order[i]))
+				for (int f = 0; f < MemoryFields; f++)
+					csvRow(out, order[i], memoryField(f), summarize(memoryColumn(order[i], f)));
+		}
+		//object sizes are single values, repeated in every statistic column
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			double b = (double)objects[i].second;
+			Summary s = { b, b, b, b, b };
+			csvRow(out, objects[i].first, "bytes", s);
+		}
+	}
+
+private:
+	struct Clock
+	{
+		std::chrono::steady_clock::time_point wall;
+		std::clock_t cpu;
+		MemoryMeter memory;
+	};
+
+	enum { MemoryFields = 5 };
+
+	static const char *memoryField(int f)
+	{
+		static const char *names[MemoryFields] = { "peak_rss", "heap_peak", "allocated", "allocations", "pool" };
+		return names[f];
+	}
+
+	std::vector<double> memoryColumn(const std::string &phase, int f) const
+	{
+		std::vector<double> out;
+		std::map<std::string, std::vector<MemorySample> >::const_iterator it = memory.find(phase);
+		if (it == memory.end())
+			return out;
+		for (size_t i = 0; i < it->second.size(); i++)
+		{
+			const MemorySample &m = it->second[i];
+			double v[MemoryFields] = { (double)m.peakRss, (double)m.heapPeak, (double)m.allocated,
+				(double)m.allocations, (double)m.pool };
+			out.push_back(v[f]);
+		}
+		return out;
+	}
+
+	std::vector<double> column(const std::string &phase, bool cpu) const
+	{
+		std::vector<double> out;
+		std::map<std::string, std::vector<PhaseSample> >::const_iterator it = samples.find(phase);
+		if (it == samples.end())
+			return out;
+		for (size_t i = 0; i < it->second.size(); i++)
+			out.push_back(cpu ? it->second[i].cpu : it->second[i].wall);
+		return out;
+	}
+
+	static void printRow(std::ostream &out, const std::string &phase, const char *clock, const Summary &s)
+	{
+		out << std::left << std::setw(14) << phase << std::setw(6) << clock << std::right << std::fixed
+			<< std::setprecision(6) << std::setw(12) << s.min << std::setw(12) << s.median
+			<< std::setw(12) << s.p95 << std::setw(12) << s.p99 << std::endl;
+		out.unsetf(std::ios::fixed);
+	}
+
+	static void jsonSummary(std::ostream &out, const char *clock, const Summary &s)
+	{
+		out << ", \"" << clock << "\": { \"min\": " << s.min << ", \"median\": " << s.median
+			<< ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << ", \"mean\": " << s.mean << " }";
+	}
+
+	void csvRow(std::ostream &out, const std::string &phase, const char *clock, const Summary &s) const
+	{
+		out << name << "," << phase << "," << clock << "," << s.min << "," << s.median << ","
+			<< s.p95 << "," << s.p99 << "," << s.mean << "\n";
+	}
+
+	void finish() const
+	{
+		report(std::cout);
+		if (!json_path.empty())
+		{
+			std::ofstream f(json_path.c_str());
+			writeJson(f);
+		}
+		if (!csv_path.empty())
+		{
+			std::ofstream f(csv_path.c_str());
+			writeCsv(f);
+		}
+		if (!trace_path.empty())
+			traceFlush();
+	}
+
+	std::string name;
+	int warmup;
+	int reps;
+	int run_index;
+	std::string json_path;
+	std::string csv_path;
+	std::string trace_path;
+	std::map<std::string, Clock> open;
+	std::vector<std::string> order;
+	std::map<std::string, std::vector<PhaseSample> > samples;
+	std::map<std::string, std::vector<MemorySample> > memory;
+	std::function<size_t()> pool_probe;
+	std::vector<std::pair<std::string, size_t> > objects;
+};
+
+//Median wall time per phase at several thread counts, with speedup and
+//parallel efficiency relative to the smallest count measured
+class ScalingReport
+{
+public:
+	explicit ScalingReport(const std::string &name) : name(name) {}
+
+	void add(int threads, const Benchmark &bench)
+	{
+		counts.push_back(threads);
+		std::map<std::string, double> row;
+		for (size_t i = 0; i < bench.phases().size(); i++)
+		{
+			const std::string &phase = bench.phases()[i];
+			if (std::find(order.begin(), order.end(), phase) == order.end())
+				order.push_back(phase);
+			row[phase] = bench.summary(phase).median;
+		}
+		medians.push_back(row);
+	}
+
+	void print(std::ostream &out) const
+	{
+		out << std::endl << "Scaling for " << name << " (median wall seconds, speedup, efficiency):" << std::endl;
+		for (size_t p = 0; p < order.size(); p++)
+		{
+			out << order[p] << std::endl;
+			for (size_t i = 0; i < counts.size(); i++)
+			{
+				double s = speedup(order[p], i);
+				out << "  " << std::setw(3) << counts[i] << " threads " << std::fixed << std::setprecision(6)
+					<< std::setw(12) << value(order[p], i) << std::setprecision(2) << std::setw(8) << s << "x"
+					<< std::setw(8) << 100.0 * s * counts[0] / counts[i] << "%" << std::endl;
+				out.unsetf(std::ios::fixed);
+			}
+		}
+	}
+
+	void writeCsv(std::ostream &out) const
+	{
+		out << "program,phase,threads,median,speedup,efficiency\n";
+		for (size_t p = 0; p < order.size(); p++)
+			for (size_t i = 0; i < counts.size(); i++)
+			{
+				double s = speedup(order[p], i);
+				out << name << "," << order[p] << "," << counts[i] << "," << value(order[p], i) << ","
+					<< s << "," << s * counts[0] / counts[i] << "\n";
+			}
+	}
+
+private:
+	double value(const std::string &phase, size_t i) const
+	{
+		std::map<std::string, double>::const_iterator it = medians[i].find(phase);
+		return it == medians[i].end() ? 0 : it->second;
+	}
+
+	double speedup(const std::string &phase, size_t i) const
+	{
+		double t = value(phase, i);
+		return t > 0 ? value(phase, 0) / t : 0;
+	}
+
+	std::string name;
+	std::vector<int> counts;
+	std::vector<std::string> order;
+	std::vector<std::map<std::string, double> > medians;
+};
+
+#endif
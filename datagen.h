@@ -0,0 +1,83 @@
+/***************************************/
+/* Workload data generator             */
+/* Counter-based: row i of a column is */
+/* a hash of (seed, column, i), so any */
+/* block of rows is generated on its   */
+/* own - in parallel, in any chunking  */
+/* - and the first N rows are the same */
+/* at every size and on every backend. */
+/***************************************/
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+//Value ranges of the original programs: x < 25, y < 50, z < 30
+enum WorkloadColumn { ColumnX = 0, ColumnY = 1, ColumnZ = 2 };
+
+inline double columnRange(WorkloadColumn column)
+{
+	static const double range[] = { 25, 50, 30 };
+	return range[column];
+}
+
+//SplitMix64 finalizer: a bijection whose output bits all depend on every input bit
+inline uint64_t mix64(uint64_t z)
+{
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+const uint64_t GoldenGamma = 0x9e3779b97f4a7c15ULL;
+
+//Each (seed, column) pair gets its own counter stream
+inline uint64_t streamKey(uint64_t seed, WorkloadColumn column)
+{
+	return mix64(mix64(seed) + (uint64_t)column * GoldenGamma + 1);
+}
+
+//Rows first .. first+n-1: uniform in [0, range), or its floor for integer
+//schemes. No branches or carried state, so the loop vectorizes.
+template <class T>
+inline void fillBlock(T *out, size_t n, uint64_t first, uint64_t key, double range, bool integer)
+{
+	const double scale = range / 9007199254740992.0;  //2^53
+	const double top = range - 1;
+	for (size_t i = 0; i < n; i++)
+	{
+		double v = (double)(int64_t)(mix64(key + (first + i) * GoldenGamma) >> 11) * scale;
+		out[i] = (T)(integer ? std::min(std::floor(v), top) : v);
+	}
+}
+
+//Rows first .. first+n-1 of a column into out, split across threads once n is
+//large enough to pay for them
+template <class T>
+inline void fillColumn(T *out, size_t n, uint64_t first, uint64_t seed, WorkloadColumn column, bool integer)
+{
+	const size_t min_rows = 1 << 16;
+	uint64_t key = streamKey(seed, column);
+	double range = columnRange(column);
+	size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), n / min_rows);
+	if (threads <= 1)
+	{
+		fillBlock(out, n, first, key, range, integer);
+		return;
+	}
+	std::vector<std::thread> pool;
+	size_t block = (n + threads - 1) / threads;
+	for (size_t b = 0; b < n; b += block)
+	{
+		size_t len = std::min(block, n - b);
+		pool.push_back(std::thread([=] { fillBlock(out + b, len, first + b, key, range, integer); }));
+	}
+	for (size_t t = 0; t < pool.size(); t++)
+		pool[t].join();
+}
+
+#endif
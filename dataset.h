@@ -0,0 +1,347 @@
+/***************************************/
+/* Columnar binary datasets            */
+/* Plain columns (inputs, decrypted    */
+/* results) are read through mmap and  */
+/* handed to encode without copying.   */
+/* Encrypted columns are stored in     */
+/* slot-sized chunks, so a dataset is  */
+/* encrypted once and evaluated many   */
+/* times.                              */
+/*                                     */
+/* Both formats are in host byte order */
+/* and meant for the machine or        */
+/* cluster that wrote them.            */
+/***************************************/
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include "he_backend.h"
+
+//Read-only mapping of a whole file
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string &path) : base(0), length(0)
+	{
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw std::runtime_error("cannot open " + path);
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			length = (size_t)st.st_size;
+			void *p = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			base = p == MAP_FAILED ? 0 : (const char *)p;
+		}
+		close(fd);
+		if (!base)
+			throw std::runtime_error("cannot map " + path);
+	}
+
+	~MappedFile() { munmap((void *)base, length); }
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	const char *data() const { return base; }
+	size_t size() const { return length; }
+
+private:
+	const char *base;
+	size_t length;
+};
+
+//Plain columns: a 32-byte header, one 32-byte name per column, then every
+//column's values in turn. Float64 columns hold the values; int64 columns hold
+//llround(value * scale).
+enum class ValueType : uint32_t { Float64 = 0, Int64 = 1 };
+
+struct DatasetHeader
+{
+	char magic[8];       //"HECOLS1"
+	uint32_t type;       //ValueType
+	uint32_t columns;
+	uint64_t rows;
+	double scale;
+};
+
+static_assert(sizeof(DatasetHeader) == 32, "dataset header layout");
+
+const size_t DatasetNameBytes = 32;
+
+typedef std::vector<std::pair<std::string, ColumnSpan>> NamedSpans;
+
+//Columns must have equal length and names shorter than DatasetNameBytes
+inline void writeDataset(const std::string &path, const NamedSpans &cols, ValueType type = ValueType::Float64,
+	double scale = 1)
+{
+	DatasetHeader h;
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.magic, "HECOLS1", 8);
+	h.type = (uint32_t)type;
+	h.columns = (uint32_t)cols.size();
+	h.rows = cols.empty() ? 0 : cols[0].second.size;
+	h.scale = scale;
+
+	std::ofstream out(path.c_str(), std::ios::binary);
+	out.write((const char *)&h, sizeof(h));
+	for (size_t c = 0; c < cols.size(); c++)
+	{
+		if (cols[c].first.size() >= DatasetNameBytes || cols[c].second.size != h.rows)
+			throw std::invalid_argument("bad dataset column " + cols[c].first);
+		char name[DatasetNameBytes] = {};
+		std::memcpy(name, cols[c].first.data(), cols[c].first.size());
+		out.write(name, DatasetNameBytes);
+	}
+	for (size_t c = 0; c < cols.size(); c++)
+	{
+		const ColumnSpan &s = cols[c].second;
+		if (type == ValueType::Float64)
+		{
+			out.write((const char *)s.data, s.size * sizeof(double));
+			continue;
+		}
+		std::vector<int64_t> v(s.size);
+		for (size_t i = 0; i < s.size; i++)
+			v[i] = (int64_t)std::llround(s.data[i] * scale);
+		out.write((const char *)v.data(), v.size() * sizeof(int64_t));
+	}
+	if (!out)
+		throw std::runtime_error("cannot write " + path);
+}
+
+class MappedDataset
+{
+public:
+	explicit MappedDataset(const std::string &path) : file(path)
+	{
+		if (file.size() < sizeof(DatasetHeader))
+			throw std::runtime_error(path + " is not a dataset");
+		std::memcpy(&h, file.data(), sizeof(h));
+		//the header's counts are untrusted, so the body is divided up rather
+		//than the expected size multiplied out
+		uint64_t body = file.size() - sizeof(h);
+		bool sized = h.columns ? body % h.columns == 0 && body / h.columns >= DatasetNameBytes &&
+				h.rows <= body / 8 && body / h.columns - DatasetNameBytes == h.rows * 8
+			: body == 0;
+		if (std::memcmp(h.magic, "HECOLS1", 8) != 0 || h.type > (uint32_t)ValueType::Int64 || !sized)
+			throw std::runtime_error(path + " is not a dataset");
+		for (uint32_t c = 0; c < h.columns; c++)
+		{
+			const char *name = file.data() + sizeof(h) + c * DatasetNameBytes;
+			names.push_back(std::string(name, strnlen(name, DatasetNameBytes)));
+		}
+	}
+
+	size_t rows() const { return (size_t)h.rows; }
+	ValueType type() const { return (ValueType)h.type; }
+	double scale() const { return h.scale; }
+	const std::vector<std::string> &columns() const { return names; }
+	bool has(const std::string &name) const { return find(name) >= 0; }
+
+	//The mapped values themselves; float64 datasets only
+	ColumnSpan column(const std::string &name) const
+	{
+		if (type() != ValueType::Float64)
+			throw std::invalid_argument("int64 dataset columns need values()");
+		return ColumnSpan((const double *)at(name), rows());
+	}
+
+	//A copy of the values of any column type, with int64 columns unscaled
+	std::vector<double> values(const std::string &name) const
+	{
+		if (type() == ValueType::Float64)
+		{
+			ColumnSpan s = column(name);
+			return std::vector<double>(s.data, s.data + s.size);
+		}
+		const int64_t *v = (const int64_t *)at(name);
+		std::vector<double> out(rows());
+		for (size_t i = 0; i < out.size(); i++)
+			out[i] = v[i] / h.scale;
+		return out;
+	}
+
+private:
+	int find(const std::string &name) const
+	{
+		for (size_t c = 0; c < names.size(); c++)
+			if (names[c] == name)
+				return (int)c;
+		return -1;
+	}
+
+	const char *at(const std::string &name) const
+	{
+		int c = find(name);
+		if (c < 0)
+			throw std::invalid_argument("dataset has no column " + name);
+		return file.data() + sizeof(h) + h.columns * DatasetNameBytes + c * h.rows * 8;
+	}
+
+	MappedFile file;
+	DatasetHeader h;
+	std::vector<std::string> names;
+};
+
+//Encrypted columns: "HECT1", then length-prefixed strings for the parameters
+//(describeParams, so the keys can be checked), the wire format and each column
+//name, the row and chunk counts, an offset table with one entry per chunk and
+//column, and the serialized ciphertexts.
+inline void writeString(std::ostream &out, const std::string &s)
+{
+	uint32_t n = (uint32_t)s.size();
+	out.write((const char *)&n, sizeof(n));
+	out.write(s.data(), n);
+}
+
+inline void writeU64(std::ostream &out, uint64_t v)
+{
+	out.write((const char *)&v, sizeof(v));
+}
+
+//Encrypt each column in chunks of he.slotCount() rows; he's keys must be the
+//ones the dataset will be evaluated with (see KeyCache)
+inline void writeEncrypted(HEBackend &he, const std::string &params, const std::string &path, const NamedSpans &cols,
+	const std::string &format)
+{
+	uint64_t rows = cols.empty() ? 0 : cols[0].second.size;
+	for (size_t c = 0; c < cols.size(); c++)
+		if (cols[c].second.size != rows)
+			throw std::invalid_argument("encrypted columns must have equal length");
+	size_t slots = he.slotCount();
+	uint64_t chunks = (rows + slots - 1) / slots;
+
+	std::ofstream out(path.c_str(), std::ios::binary);
+	out.write("HECT1\0\0\0", 8);
+	writeString(out, params);
+	writeString(out, format);
+	writeU64(out, cols.size());
+	for (size_t c = 0; c < cols.size(); c++)
+		writeString(out, cols[c].first);
+	writeU64(out, rows);
+	writeU64(out, chunks);
+
+	//offsets are filled in once the chunks are written
+	std::streamoff table = out.tellp();
+	std::vector<uint64_t> offsets(chunks * cols.size() + 1);
+	out.write((const char *)offsets.data(), offsets.size() * sizeof(uint64_t));
+	for (uint64_t k = 0; k < chunks; k++)
+		for (size_t c = 0; c < cols.size(); c++)
+		{
+			const ColumnSpan &s = cols[c].second;
+			size_t n = std::min<size_t>(slots, s.size - k * slots);
+			offsets[k * cols.size() + c] = (uint64_t)out.tellp();
+			he.encryptTo(he.encode(ColumnSpan(s.data + k * slots, n)), out, format);
+		}
+	offsets.back() = (uint64_t)out.tellp();
+	out.seekp(table);
+	out.write((const char *)offsets.data(), offsets.size() * sizeof(uint64_t));
+	if (!out)
+		throw std::runtime_error("cannot write " + path);
+}
+
+//Serves loadCiphertext straight from the mapping
+class SpanBuffer : public std::streambuf
+{
+public:
+	SpanBuffer(const char *data, size_t size)
+	{
+		char *p = const_cast<char *>(data);
+		setg(p, p, p + size);
+	}
+};
+
+class EncryptedDataset
+{
+public:
+	explicit EncryptedDataset(const std::string &path) : file(path), pos(8)
+	{
+		if (file.size() < 8 || std::memcmp(file.data(), "HECT1\0\0\0", 8) != 0)
+			throw std::runtime_error(path + " is not an encrypted dataset");
+		param_text = readString();
+		wire_format = readString();
+		uint64_t cols = readU64();
+		for (uint64_t c = 0; c < cols; c++)
+			names.push_back(readString());
+		row_count = readU64();
+		chunk_count = readU64();
+		//the table must fit in what is left of the file before it is sized
+		uint64_t room = (file.size() - pos) / sizeof(uint64_t);
+		if (cols && chunk_count > (room ? room - 1 : 0) / cols)
+			throw std::runtime_error(path + " is truncated");
+		offsets.resize(chunk_count * cols + 1);
+		std::memcpy(offsets.data(), take(offsets.size() * sizeof(uint64_t)), offsets.size() * sizeof(uint64_t));
+		//load sizes each chunk as offsets[k + 1] - offsets[k]
+		for (size_t k = 0; k < offsets.size(); k++)
+			if (offsets[k] < (k ? offsets[k - 1] : pos) || offsets[k] > file.size())
+				throw std::runtime_error(path + " has a bad chunk offset table");
+	}
+
+	//describeParams of the backend and parameters that encrypted it
+	const std::string &params() const { return param_text; }
+	const std::string &format() const { return wire_format; }
+	const std::vector<std::string> &columns() const { return names; }
+	size_t rows() const { return (size_t)row_count; }
+	size_t chunks() const { return (size_t)chunk_count; }
+
+	CipherPtr load(HEBackend &he, size_t chunk, const std::string &column) const
+	{
+		size_t c = 0;
+		while (c < names.size() && names[c] != column)
+			c++;
+		if (c == names.size() || chunk >= chunk_count)
+			throw std::invalid_argument("no chunk " + std::to_string(chunk) + " of column " + column);
+		size_t k = chunk * names.size() + c;
+		SpanBuffer buf(file.data() + offsets[k], (size_t)(offsets[k + 1] - offsets[k]));
+		std::istream in(&buf);
+		return he.loadCiphertext(in);
+	}
+
+private:
+	const char *take(size_t n)
+	{
+		if (n > file.size() - pos)
+			throw std::runtime_error("encrypted dataset header is truncated");
+		const char *p = file.data() + pos;
+		pos += n;
+		return p;
+	}
+
+	uint64_t readU64()
+	{
+		uint64_t v;
+		std::memcpy(&v, take(sizeof(v)), sizeof(v));
+		return v;
+	}
+
+	std::string readString()
+	{
+		uint32_t n;
+		std::memcpy(&n, take(sizeof(n)), sizeof(n));
+		return std::string(take(n), n);
+	}
+
+	MappedFile file;
+	size_t pos;
+	std::string param_text, wire_format;
+	std::vector<std::string> names;
+	uint64_t row_count, chunk_count;
+	std::vector<uint64_t> offsets;
+};
+
+#endif
@@ -0,0 +1,654 @@
+/***************************************/
+/* Expression front-end                */
+/* Parses circuits such as y*(x+z) or  */
+/* x^2+y*z, factors common terms out   */
+/* of sums, shares common              */
+/* subexpressions and balances         */
+/* products by depth before lowering   */
+/* them to HEBackend calls.            */
+/***************************************/
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "he_backend.h"
+
+struct Expr;
+typedef std::shared_ptr<const Expr> ExprPtr;
+
+struct Expr
+{
+	enum Kind { Var, Add, Mul, Pow };
+
+	Kind kind;
+	std::string name;           //Var
+	std::vector<ExprPtr> args;  //Add, Mul; the base of Pow
+	int exponent;               //Pow
+	std::string key;            //canonical text, equal for equal expressions
+};
+
+inline ExprPtr makeVar(const std::string &name)
+{
+	std::shared_ptr<Expr> e(new Expr);
+	e->kind = Expr::Var;
+	e->name = e->key = name;
+	e->exponent = 1;
+	return e;
+}
+
+//Operands keep their order; normalizeExpr sorts them
+inline ExprPtr makeNary(Expr::Kind kind, const std::vector<ExprPtr> &args)
+{
+	if (args.size() == 1)
+		return args[0];
+	std::shared_ptr<Expr> e(new Expr);
+	e->kind = kind;
+	e->args = args;
+	e->exponent = 1;
+	e->key = "(";
+	for (size_t i = 0; i < args.size(); i++)
+		e->key += (i ? (kind == Expr::Add ? "+" : "*") : "") + args[i]->key;
+	e->key += ")";
+	return e;
+}
+
+inline ExprPtr makeAdd(const ExprPtr &a, const ExprPtr &b) { return makeNary(Expr::Add, { a, b }); }
+inline ExprPtr makeMul(const ExprPtr &a, const ExprPtr &b) { return makeNary(Expr::Mul, { a, b }); }
+
+inline ExprPtr makePow(const ExprPtr &base, int exponent)
+{
+	if (exponent < 1)
+		throw std::invalid_argument("exponents must be positive integers");
+	if (exponent == 1)
+		return base;
+	std::shared_ptr<Expr> e(new Expr);
+	e->kind = Expr::Pow;
+	e->args.push_back(base);
+	e->exponent = exponent;
+	e->key = "(" + base->key + "^" + std::to_string(exponent) + ")";
+	return e;
+}
+
+//Recursive descent over sum := product ('+' product)*, product := power ('*' power)*,
+//power := atom ('^' integer)?, atom := name | '(' sum ')'
+class ExprParser
+{
+public:
+	explicit ExprParser(const std::string &text) : s(text), pos(0) {}
+
+	ExprPtr parse()
+	{
+		ExprPtr e = sum();
+		skip();
+		if (pos != s.size())
+			fail("unexpected '" + s.substr(pos, 1) + "'");
+		return e;
+	}
+
+private:
+	ExprPtr sum()
+	{
+		ExprPtr e = product();
+		while (accept('+'))
+			e = makeAdd(e, product());
+		return e;
+	}
+
+	ExprPtr product()
+	{
+		ExprPtr e = power();
+		while (accept('*'))
+			e = makeMul(e, power());
+		return e;
+	}
+
+	ExprPtr power()
+	{
+		ExprPtr e = atom();
+		if (!accept('^'))
+			return e;
+		skip();
+		size_t start = pos;
+		while (pos < s.size() && std::isdigit((unsigned char)s[pos]))
+			pos++;
+		if (start == pos)
+			fail("expected an integer exponent");
+		return makePow(e, std::stoi(s.substr(start, pos - start)));
+	}
+
+	ExprPtr atom()
+	{
+		if (accept('('))
+		{
+			ExprPtr e = sum();
+			if (!accept(')'))
+				fail("expected ')'");
+			return e;
+		}
+		skip();
+		size_t start = pos;
+		while (pos < s.size() && (std::isalnum((unsigned char)s[pos]) || s[pos] == '_'))
+			pos++;
+		if (start == pos)
+			fail("expected a variable");
+		if (std::isdigit((unsigned char)s[start]))
+			fail("constants are not supported, only ciphertext variables");
+		return makeVar(s.substr(start, pos - start));
+	}
+
+	bool accept(char c)
+	{
+		skip();
+		if (pos < s.size() && s[pos] == c)
+		{
+			pos++;
+			return true;
+		}
+		return false;
+	}
+
+	void skip()
+	{
+		while (pos < s.size() && std::isspace((unsigned char)s[pos]))
+			pos++;
+	}
+
+	void fail(const std::string &what) const
+	{
+		throw std::invalid_argument("expression \"" + s + "\" at " + std::to_string(pos) + ": " + what);
+	}
+
+	std::string s;
+	size_t pos;
+};
+
+inline ExprPtr parseExpr(const std::string &text)
+{
+	return ExprParser(text).parse();
+}
+
+//Factors of a product: base key -> (base, exponent)
+typedef std::map<std::string, std::pair<ExprPtr, int>> Factors;
+
+inline Factors factorsOf(const ExprPtr &e)
+{
+	Factors f;
+	const std::vector<ExprPtr> one(1, e);
+	const std::vector<ExprPtr> &terms = e->kind == Expr::Mul ? e->args : one;
+	for (size_t i = 0; i < terms.size(); i++)
+	{
+		const ExprPtr &base = terms[i]->kind == Expr::Pow ? terms[i]->args[0] : terms[i];
+		std::pair<ExprPtr, int> &slot = f[base->key];
+		slot.first = base;
+		slot.second += terms[i]->exponent;
+	}
+	return f;
+}
+
+inline bool keyLess(const ExprPtr &a, const ExprPtr &b) { return a->key < b->key; }
+
+inline ExprPtr productOf(const Factors &f)
+{
+	std::vector<ExprPtr> terms;
+	for (Factors::const_iterator it = f.begin(); it != f.end(); ++it)
+		terms.push_back(makePow(it->second.first, it->second.second));
+	std::sort(terms.begin(), terms.end(), keyLess);
+	return makeNary(Expr::Mul, terms);
+}
+
+//Flattened sums and products with sorted operands, and repeated factors
+//collected into powers (x*y*x -> x^2*y), so equal subexpressions get equal keys
+inline ExprPtr normalizeExpr(const ExprPtr &e)
+{
+	if (e->kind == Expr::Var)
+		return e;
+	if (e->kind == Expr::Pow)
+	{
+		ExprPtr base = normalizeExpr(e->args[0]);
+		if (base->kind == Expr::Pow)
+			return makePow(base->args[0], base->exponent * e->exponent);
+		return makePow(base, e->exponent);
+	}
+
+	std::vector<ExprPtr> args;
+	for (size_t i = 0; i < e->args.size(); i++)
+	{
+		ExprPtr a = normalizeExpr(e->args[i]);
+		if (a->kind == e->kind)
+			args.insert(args.end(), a->args.begin(), a->args.end());
+		else
+			args.push_back(a);
+	}
+
+	if (e->kind == Expr::Mul)
+	{
+		Factors f;
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			Factors g = factorsOf(args[i]);
+			for (Factors::iterator it = g.begin(); it != g.end(); ++it)
+			{
+				f[it->first].first = it->second.first;
+				f[it->first].second += it->second.second;
+			}
+		}
+		return productOf(f);
+	}
+
+	std::sort(args.begin(), args.end(), keyLess);
+	return makeNary(Expr::Add, args);
+}
+
+//A lowered circuit: inputs, additions and multiplications in evaluation order.
+//Every multiplication is followed by relinearization and rescaling.
+class Circuit
+{
+public:
+	struct Op
+	{
+		enum Code { Input, Add, Mul };
+		Code code;
+		int a, b;           //operand ops
+		std::string name;   //Input
+		int depth;          //multiplicative depth of the result
+	};
+
+	//As written: one backend call per operator in the expression, no sharing
+	static Circuit lowerNaive(const ExprPtr &e)
+	{
+		Circuit c;
+		c.output = c.naive(e);
+		c.finish();
+		return c;
+	}
+
+	//Shared subexpressions and products combined shallowest-first
+	static Circuit lower(const ExprPtr &e)
+	{
+		Circuit c;
+		c.output = c.balanced(e);
+		c.finish();
+		return c;
+	}
+
+	const std::vector<Op> &ops() const { return program; }
+	size_t multiplications() const { return count(Op::Mul); }
+	size_t additions() const { return count(Op::Add); }
+	int depth() const { return program[output].depth; }
+
+	//Variable names in the order they first appear
+	std::vector<std::string> inputs() const
+	{
+		std::vector<std::string> names;
+		for (size_t i = 0; i < program.size(); i++)
+			if (program[i].code == Op::Input && std::find(names.begin(), names.end(), program[i].name) == names.end())
+				names.push_back(program[i].name);
+		return names;
+	}
+
+	std::string describe() const
+	{
+		std::ostringstream out;
+		out << multiplications() << " mul, " << additions() << " add, depth " << depth();
+		return out.str();
+	}
+
+	//Evaluate on he; every input must be present, encrypted in in or public in pub.
+	//Public-only subexpressions are computed in the clear, and an op with one
+	//public operand lowers to addPlain/multiplyPlain, which need no relinearization.
+	//Intermediates are released after their last use.
+	CipherPtr run(HEBackend &he, const std::map<std::string, CipherPtr> &in,
+		const std::map<std::string, std::vector<double>> &pub = std::map<std::string, std::vector<double>>()) const
+	{
+		std::vector<CipherPtr> val(program.size());
+		std::vector<std::vector<double>> clear(program.size());
+		for (size_t i = 0; i < program.size(); i++)
+		{
+			const Op &op = program[i];
+			if (op.code == Op::Input)
+			{
+				std::map<std::string, CipherPtr>::const_iterator it = in.find(op.name);
+				std::map<std::string, std::vector<double>>::const_iterator p = pub.find(op.name);
+				if (it != in.end())
+					val[i] = it->second;
+				else if (p != pub.end())
+					clear[i] = p->second;
+				else
+					throw std::invalid_argument("no ciphertext or public column for variable " + op.name);
+			}
+			else if (!val[op.a] && !val[op.b])
+			{
+				clear[i] = apply(op.code, clear[op.a], clear[op.b]);
+			}
+			else if (!val[op.a] || !val[op.b])
+			{
+				const CipherPtr &c = val[op.a] ? val[op.a] : val[op.b];
+				PlainPtr p = he.encode(val[op.a] ? clear[op.b] : clear[op.a]);
+				if (op.code == Op::Add)
+				{
+					val[i] = he.addPlain(c, p);
+				}
+				else
+				{
+					val[i] = he.multiplyPlain(c, p);
+					he.rescale(val[i]);
+				}
+			}
+			else if (op.code == Op::Add)
+			{
+				val[i] = he.add(val[op.a], val[op.b]);
+			}
+			else
+			{
+				val[i] = he.multiply(val[op.a], val[op.b]);
+				he.relinearize(val[i]);
+				he.rescale(val[i]);
+			}
+			release(val, i);
+			release(clear, i);
+		}
+		return val[output] ? val[output] : he.encrypt(he.encode(clear[output]));
+	}
+
+	//The same program on plaintext columns, for checking results. peak, when
+	//given, receives the largest |value| of any intermediate (for parameter planning).
+	std::vector<double> reference(const std::map<std::string, std::vector<double>> &in, double *peak = 0) const
+	{
+		std::vector<std::vector<double>> val(program.size());
+		for (size_t i = 0; i < program.size(); i++)
+		{
+			const Op &op = program[i];
+			if (op.code == Op::Input)
+			{
+				std::map<std::string, std::vector<double>>::const_iterator it = in.find(op.name);
+				if (it == in.end())
+					throw std::invalid_argument("no column for variable " + op.name);
+				val[i] = it->second;
+			}
+			else
+			{
+				val[i] = apply(op.code, val[op.a], val[op.b]);
+			}
+		}
+		if (peak)
+		{
+			*peak = 0;
+			for (size_t i = 0; i < val.size(); i++)
+				for (size_t k = 0; k < val[i].size(); k++)
+					*peak = std::max(*peak, std::fabs(val[i][k]));
+		}
+		return val[output];
+	}
+
+private:
+	Circuit() : output(-1) {}
+
+	int emit(Op::Code code, int a, int b, const std::string &name = std::string())
+	{
+		Op op;
+		op.code = code;
+		op.a = a;
+		op.b = b;
+		op.name = name;
+		op.depth = code == Op::Input ? 0 : std::max(program[a].depth, program[b].depth) + (code == Op::Mul ? 1 : 0);
+		program.push_back(op);
+		return (int)program.size() - 1;
+	}
+
+	int naive(const ExprPtr &e)
+	{
+		if (e->kind == Expr::Var)
+			return emit(Op::Input, -1, -1, e->name);
+		if (e->kind == Expr::Pow)
+		{
+			int acc = naive(e->args[0]);
+			for (int k = 1; k < e->exponent; k++)
+				acc = emit(Op::Mul, acc, naive(e->args[0]));
+			return acc;
+		}
+		int acc = naive(e->args[0]);
+		for (size_t i = 1; i < e->args.size(); i++)
+			acc = emit(e->kind == Expr::Add ? Op::Add : Op::Mul, acc, naive(e->args[i]));
+		return acc;
+	}
+
+	//Reuses an identical op when one exists (common-subexpression elimination)
+	int shared(Op::Code code, int a, int b, const std::string &name = std::string())
+	{
+		if (code != Op::Input && b < a)
+			std::swap(a, b);
+		std::tuple<int, int, int, std::string> k(code, a, b, name);
+		std::map<std::tuple<int, int, int, std::string>, int>::iterator it = seen.find(k);
+		if (it != seen.end())
+			return it->second;
+		return seen[k] = emit(code, a, b, name);
+	}
+
+	//Repeated squaring: the ops whose product is base^exponent, each of depth <= log2
+	void powers(int base, int exponent, std::vector<int> &out)
+	{
+		for (int sq = base; exponent > 0; exponent >>= 1)
+		{
+			if (exponent & 1)
+				out.push_back(sq);
+			if (exponent > 1)
+				sq = shared(Op::Mul, sq, sq);
+		}
+	}
+
+	//Operands of a product; powers are expanded so their squares join the balancing.
+	//Nested products stay whole, so a repeated one is computed once.
+	void factors(const ExprPtr &e, std::vector<int> &out)
+	{
+		const std::vector<ExprPtr> one(1, e);
+		const std::vector<ExprPtr> &terms = e->kind == Expr::Mul ? e->args : one;
+		for (size_t i = 0; i < terms.size(); i++)
+		{
+			if (terms[i]->kind == Expr::Pow)
+				powers(balanced(terms[i]->args[0]), terms[i]->exponent, out);
+			else
+				out.push_back(balanced(terms[i]));
+		}
+	}
+
+	//Always combine the two shallowest operands, which gives the least depth
+	int combine(Op::Code code, std::vector<int> operands)
+	{
+		typedef std::pair<int, int> Item;  //(depth, op)
+		std::multiset<Item> queue;
+		for (size_t i = 0; i < operands.size(); i++)
+			queue.insert(Item(program[operands[i]].depth, operands[i]));
+		while (queue.size() > 1)
+		{
+			int a = queue.begin()->second;
+			queue.erase(queue.begin());
+			int b = queue.begin()->second;
+			queue.erase(queue.begin());
+			int c = shared(code, a, b);
+			queue.insert(Item(program[c].depth, c));
+		}
+		return queue.begin()->second;
+	}
+
+	int balanced(const ExprPtr &e)
+	{
+		std::map<std::string, int>::iterator memo = lowered.find(e->key);
+		if (memo != lowered.end())
+			return memo->second;
+
+		int op;
+		if (e->kind == Expr::Var)
+		{
+			op = shared(Op::Input, -1, -1, e->name);
+		}
+		else if (e->kind == Expr::Add)
+		{
+			std::vector<int> terms;
+			for (size_t i = 0; i < e->args.size(); i++)
+				terms.push_back(balanced(e->args[i]));
+			op = combine(Op::Add, terms);
+		}
+		else
+		{
+			std::vector<int> terms;
+			factors(e, terms);
+			op = combine(Op::Mul, terms);
+		}
+		return lowered[e->key] = op;
+	}
+
+	size_t count(Op::Code code) const
+	{
+		size_t n = 0;
+		for (size_t i = 0; i < program.size(); i++)
+			n += program[i].code == code;
+		return n;
+	}
+
+	//last[i]: the final op reading op i
+	void finish()
+	{
+		last.assign(program.size(), -1);
+		for (size_t i = 0; i < program.size(); i++)
+			if (program[i].code != Op::Input)
+				last[program[i].a] = last[program[i].b] = (int)i;
+		seen.clear();
+		lowered.clear();
+	}
+
+	//Slot-wise sum or product of two cleartext columns
+	static std::vector<double> apply(Op::Code code, const std::vector<double> &a, const std::vector<double> &b)
+	{
+		std::vector<double> out(std::min(a.size(), b.size()));
+		for (size_t k = 0; k < out.size(); k++)
+			out[k] = code == Op::Add ? a[k] + b[k] : a[k] * b[k];
+		return out;
+	}
+
+	template <class T>
+	void release(std::vector<T> &val, size_t i) const
+	{
+		const Op &op = program[i];
+		if (op.code == Op::Input)
+			return;
+		if (last[op.a] == (int)i && op.a != output)
+			val[op.a] = T();
+		if (last[op.b] == (int)i && op.b != output)
+			val[op.b] = T();
+	}
+
+	std::vector<Op> program;
+	int output;
+	std::vector<int> last;
+	std::map<std::tuple<int, int, int, std::string>, int> seen;
+	std::map<std::string, int> lowered;
+};
+
+//Depth first, then multiplications: depth sets the parameters every operation pays for
+inline bool cheaper(const Circuit &a, const Circuit &b)
+{
+	if (a.depth() != b.depth())
+		return a.depth() < b.depth();
+	return a.multiplications() < b.multiplications();
+}
+
+//Pull a factor shared by several terms out of a sum: a*b + a*c -> a*(b+c).
+//Factors are tried most-shared first; the first that makes the circuit cheaper is kept.
+inline ExprPtr factorSum(const ExprPtr &sum)
+{
+	ExprPtr best = normalizeExpr(sum);
+	if (best->kind != Expr::Add)
+		return best;
+	const std::vector<ExprPtr> &terms = best->args;
+
+	std::vector<Factors> f(terms.size());
+	std::map<std::string, int> uses;
+	for (size_t i = 0; i < terms.size(); i++)
+	{
+		f[i] = factorsOf(terms[i]);
+		for (Factors::iterator it = f[i].begin(); it != f[i].end(); ++it)
+			uses[it->first]++;
+	}
+	std::vector<std::pair<int, std::string>> order;
+	for (std::map<std::string, int>::iterator it = uses.begin(); it != uses.end(); ++it)
+		if (it->second > 1)
+			order.push_back(std::make_pair(-it->second, it->first));
+	std::sort(order.begin(), order.end());
+
+	Circuit cost = Circuit::lower(best);
+	for (size_t c = 0; c < order.size(); c++)
+	{
+		const std::string &key = order[c].second;
+		int e = 0;
+		ExprPtr base;
+		for (size_t i = 0; i < terms.size(); i++)
+			if (f[i].count(key) && (e == 0 || f[i][key].second < e))
+			{
+				base = f[i][key].first;
+				e = f[i][key].second;
+			}
+
+		//a term that is all factor would leave a constant 1, which circuits cannot hold
+		std::vector<ExprPtr> inner, rest;
+		bool whole = true;
+		for (size_t i = 0; i < terms.size() && whole; i++)
+		{
+			if (!f[i].count(key))
+			{
+				rest.push_back(terms[i]);
+				continue;
+			}
+			Factors g = f[i];
+			if ((g[key].second -= e) == 0)
+				g.erase(key);
+			whole = !g.empty();
+			inner.push_back(productOf(g));
+		}
+		if (!whole)
+			continue;
+
+		rest.push_back(makeMul(makePow(base, e), factorSum(makeNary(Expr::Add, inner))));
+		ExprPtr candidate = factorSum(makeNary(Expr::Add, rest));
+		Circuit lowered = Circuit::lower(candidate);
+		if (cheaper(lowered, cost))
+			return candidate;
+	}
+	return best;
+}
+
+//Normalized bottom-up, with common factors pulled out of every sum
+inline ExprPtr optimizeExpr(const ExprPtr &e)
+{
+	ExprPtr n = normalizeExpr(e);
+	if (n->kind == Expr::Var)
+		return n;
+	std::vector<ExprPtr> args;
+	for (size_t i = 0; i < n->args.size(); i++)
+		args.push_back(optimizeExpr(n->args[i]));
+	if (n->kind == Expr::Pow)
+		return normalizeExpr(makePow(args[0], n->exponent));
+	ExprPtr rebuilt = normalizeExpr(makeNary(n->kind, args));
+	return rebuilt->kind == Expr::Add ? factorSum(rebuilt) : rebuilt;
+}
+
+//The cheaper of the optimized expression and the one as written, both with sharing.
+//Normalizing can hide sharing the author wrote, as in (x*y)*(x*y).
+inline Circuit compileExpr(const ExprPtr &e)
+{
+	Circuit optimized = Circuit::lower(optimizeExpr(e));
+	Circuit written = Circuit::lower(e);
+	return cheaper(written, optimized) ? written : optimized;
+}
+
+#endif
@@ -0,0 +1,208 @@
+/***************************************/
+/* Backend-neutral HE interface        */
+/* One context, key set, encoder and   */
+/* evaluator per backend; workloads    */
+/* are written once against HEBackend  */
+/* and run on SEAL, PALISADE or HElib. */
+/***************************************/
+#ifndef HE_BACKEND_H
+#define HE_BACKEND_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "pool.h"
+
+enum class Scheme { BFV, BGV, CKKS };
+
+//Parameters understood by every adapter; fields a library has no use for are ignored.
+struct HEParams
+{
+	Scheme scheme;
+	size_t ringDim;              //SEAL poly_modulus_degree / PALISADE ring dimension, 0 = from security level
+	uint64_t plainModulus;       //BFV/BGV plaintext modulus (SEAL/PALISADE t, HElib p)
+	int plainBits;               //SEAL: bit size for PlainModulus::Batching when plainModulus is 0
+	std::vector<int> coeffBits;  //SEAL modulus chain, empty = BFVDefault
+	int scaleBits;               //CKKS scale 2^scaleBits
+	int depth;                   //multiplicative depth
+	int securityBits;            //128, 192 or 256
+	long m, bits, c, r;          //HElib cyclotomic index, modulus chain bits, key-switching columns, lifting
+
+	HEParams(Scheme s = Scheme::BFV)
+		: scheme(s), ringDim(0), plainModulus(0), plainBits(20), scaleBits(40), depth(1),
+		  securityBits(128), m(0), bits(0), c(2), r(1)
+	{
+	}
+};
+
+//Opaque library objects; each adapter derives its own and casts back.
+class HEPlaintext
+{
+public:
+	virtual ~HEPlaintext() {}
+};
+
+class HECiphertext
+{
+public:
+	virtual ~HECiphertext() {}
+};
+
+//Non-owning view of a contiguous column: a vector, part of one, or a
+//mapped file. The caller keeps the buffer alive while it is encoded.
+struct ColumnSpan
+{
+	const double *data;
+	size_t size;
+
+	ColumnSpan(const double *data, size_t size) : data(data), size(size) {}
+	ColumnSpan(const std::vector<double> &v) : data(v.data()), size(v.size()) {}
+};
+
+typedef std::shared_ptr<HEPlaintext> PlainPtr;
+typedef std::shared_ptr<HECiphertext> CipherPtr;
+
+//After keyGen, adapters accept concurrent calls from several threads as
+//long as no two calls write the same ciphertext (see stream.h, parallel.h).
+class HEBackend
+{
+public:
+	virtual ~HEBackend() {}
+
+	//"seal-bfv", "palisade-ckks", "helib-bgv", ...
+	virtual std::string name() const = 0;
+	virtual Scheme scheme() const = 0;
+
+	//Parameters matching the hand-picked choices of the original program
+	virtual HEParams defaultParams() const = 0;
+
+	virtual void createContext(const HEParams &params) = 0;
+
+	//Public/secret key pair only; evaluation keys are generated separately
+	//for what the circuit needs (see keys.h)
+	virtual void keyGen() = 0;
+	//Relinearization keys
+	virtual void relinKeyGen() = 0;
+	//Rotation (Galois) keys for the given slot offsets, added to those made before
+	virtual void rotationKeyGen(const std::vector<int> &steps) = 0;
+	//Serialized size of the evaluation keys generated so far
+	virtual size_t keyBytes() const = 0;
+
+	//Write the context parameters and every generated key into dir (which
+	//must exist); loadKeys replaces createContext and keyGen with a reload.
+	virtual void saveKeys(const std::string &dir) const = 0;
+	//As saveKeys without the secret key: what an evaluation server holds.
+	//Loading such a directory allows encrypt and evaluation only; decrypting
+	//or generating keys throws.
+	virtual void savePublicKeys(const std::string &dir) const = 0;
+	virtual void loadKeys(const std::string &dir, const HEParams &params) = 0;
+
+	virtual size_t slotCount() const = 0;
+	//Slots a rotation cycles through. SEAL and PALISADE batching for BFV/BGV
+	//rotate two rows of N/2 independently, everything else the full vector.
+	virtual size_t rowSize() const { return slotCount(); }
+
+	//Slot i takes values[i], packed straight from the caller's buffer; values
+	//past slotCount() are ignored. With BFV/BGV batching slot i is row
+	//i / rowSize(), column i % rowSize(). Integer schemes round the values;
+	//decoded values are signed.
+	virtual PlainPtr encode(ColumnSpan values) = 0;
+	virtual std::vector<double> decode(const PlainPtr &plain) = 0;
+
+	virtual CipherPtr encrypt(const PlainPtr &plain) = 0;
+	virtual PlainPtr decrypt(const CipherPtr &cipher) = 0;
+
+	virtual CipherPtr add(const CipherPtr &a, const CipherPtr &b) = 0;
+	//Ciphertext product without relinearization
+	virtual CipherPtr multiply(const CipherPtr &a, const CipherPtr &b) = 0;
+	virtual void relinearize(CipherPtr &cipher) = 0;
+	//CKKS rescale or BGV modulus switch to the next level; no-op for BFV
+	virtual void rescale(CipherPtr &cipher) = 0;
+	//Ciphertext with a public operand from encode: no relinearization key is
+	//needed and noise grows less. multiplyPlain is rescaled like multiply.
+	virtual CipherPtr addPlain(const CipherPtr &a, const PlainPtr &b) = 0;
+	virtual CipherPtr multiplyPlain(const CipherPtr &a, const PlainPtr &b) = 0;
+	//Cyclic left rotation by steps (negative rotates right)
+	virtual CipherPtr rotate(const CipherPtr &cipher, int steps) = 0;
+	//rotate by each of steps; backends that hoist decompose the ciphertext for
+	//key switching once and share it across all the rotations
+	virtual std::vector<CipherPtr> rotateMany(const CipherPtr &cipher, const std::vector<int> &steps)
+	{
+		std::vector<CipherPtr> out;
+		for (size_t i = 0; i < steps.size(); i++)
+			out.push_back(rotate(cipher, steps[i]));
+		return out;
+	}
+
+	//Serialized size of a ciphertext
+	virtual size_t ciphertextBytes(const CipherPtr &cipher) const = 0;
+	//In-memory size of a ciphertext, and of each key held by name ("public",
+	//"secret", "relin", ...), for sizing nodes
+	virtual size_t ciphertextMemory(const CipherPtr &cipher) const = 0;
+	virtual std::vector<std::pair<std::string, size_t>> keyMemory() const = 0;
+	//Bytes held by the library's own memory pool (SEAL's MemoryManager); 0 elsewhere
+	virtual size_t poolBytes() const { return 0; }
+	//Results written into recycled ciphertext and plaintext objects (pool.h);
+	//on by default, off creates every object afresh
+	virtual void setObjectPooling(bool) {}
+	virtual PoolStats objectPool() const { return PoolStats(); }
+	//Threads the library uses inside one operation: PALISADE's OpenMP team,
+	//HElib's NTL pool, 1 for single-threaded SEAL. OpenMP and NTL keep the
+	//count per calling thread, so each thread that calls in sets its own.
+	virtual size_t threads() const { return 1; }
+	virtual void setThreads(size_t) {}
+	//Remaining noise budget in bits, measured with the secret key;
+	//-1 where the library does not report one
+	virtual int noiseBudget(const CipherPtr &) const { return -1; }
+	//Noise budget estimated from the parameters and the ciphertext's level,
+	//for one that has been through depth products since encryption. Needs
+	//no secret key, so a server can choose a level; -1 as above.
+	virtual int estimateBudget(const CipherPtr &, int) const { return -1; }
+	//Copy at the next smaller modulus with the same plaintext; null at the
+	//last level or where the library switches moduli on its own
+	virtual CipherPtr modSwitch(const CipherPtr &) { return CipherPtr(); }
+
+	//Ciphertext wire formats: "binary" everywhere, plus whatever compressed or
+	//seeded forms the library can write (see seededFormat)
+	virtual std::vector<std::string> wireFormats() const { return std::vector<std::string>(1, "binary"); }
+	virtual void saveCiphertext(const CipherPtr &cipher, std::ostream &out, const std::string &format) const = 0;
+	//Reads any format this backend writes
+	virtual CipherPtr loadCiphertext(std::istream &in) = 0;
+	//Encrypt straight onto the wire, the only way to write a seeded format
+	virtual void encryptTo(const PlainPtr &plain, std::ostream &out, const std::string &format)
+	{
+		saveCiphertext(encrypt(plain), out, format);
+	}
+};
+
+//Seeded formats hold fresh symmetric encryptions whose uniformly random half
+//is replaced by the seed it was expanded from, about half the size
+inline bool seededFormat(const std::string &format)
+{
+	return format.compare(0, 6, "seeded") == 0;
+}
+
+//Reject a wire format the backend does not list
+inline void checkFormat(const HEBackend &he, const std::string &format)
+{
+	std::vector<std::string> formats = he.wireFormats();
+	if (std::find(formats.begin(), formats.end(), format) == formats.end())
+		throw std::invalid_argument(he.name() + " has no wire format " + format);
+}
+
+//Cast an opaque handle back to the adapter type, rejecting objects of another backend.
+template <class T, class Base>
+T &unwrap(const std::shared_ptr<Base> &p)
+{
+	T *t = dynamic_cast<T *>(p.get());
+	if (!t)
+		throw std::invalid_argument("object does not belong to this backend");
+	return *t;
+}
+
+#endif
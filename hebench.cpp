@@ -0,0 +1,1302 @@
+/***************************************/
+/* Benchmark runner                    */
+/* Runs e = y(x+z) through HEBackend   */
+/* on every backend in the build with  */
+/* identical data.                     */
+/*                                     */
+/* hebench [--backend NAME|all]        */
+/*         [--mode phases|stream|      */
+/*                 scaling|startup|    */
+/*                 keys|expr|plan|     */
+/*                 policy|wire|public| */
+/*                 dataset|encrypt|    */
+/*                 evaluate|aggregate| */
+/*                 hoist|precision|    */
+/*                 threads|async|poly| */
+/*                 pool]               */
+/*         [--rows N] [--seed S]       */
+/*         [--input FILE]              */
+/*         [--scale S] [--real]        */
+/*         [--out DIR] [--result DIR]  */
+/*         [--encrypted DIR]           */
+/*         [--format NAME]  (encrypt)  */
+/*         [--warmup N] [--reps N]     */
+/*         [--key-cache DIR]           */
+/*         [--inflight K] (stream,     */
+/*                         async)      */
+/*         [--workers N] (scaling,     */
+/*                        async)       */
+/*         [--threads N]  library      */
+/*                        threads; the */
+/*                        most for     */
+/*                        threads mode */
+/*         [--expr TEXT] (expr,policy, */
+/*                        public)      */
+/*         [--public a,b]   (public)   */
+/*         [--window W]  (aggregate)   */
+/*         [--rotations K]  (hoist)    */
+/*         [--rings a,b] [--scales a,b]*/
+/*         [--levels a,b] (precision)  */
+/*         [--degrees a,b]  (poly)     */
+/*         [--iterations N] (pool)     */
+/*         [--object-pool on|off]      */
+/*         [--safety BITS]  (policy)   */
+/*         [--precision BITS]  (plan)  */
+/*         [--security BITS]   (plan)  */
+/*         [--trace FILE]  (HE_TRACE   */
+/*                          builds)    */
+/***************************************/
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <string>
+#include <vector>
+#include "aggregate.h"
+#include "async.h"
+#include "backends.h"
+#include "benchmark.h"
+#include "dataset.h"
+#include "expr.h"
+#include "options.h"
+#include "parallel.h"
+#include "planner.h"
+#include "policy.h"
+#include "poly.h"
+#include "precision.h"
+#include "stream.h"
+#include "trace.h"
+#include "workload.h"
+
+using namespace std;
+
+//x/y/z from the --input dataset when given, otherwise --rows generated rows
+Columns inputColumns(const HEBackend &he, const Options &opts)
+{
+	if (!opts.has("input"))
+		return makeColumns((size_t)opts.getInt("rows", 2760), (unsigned long)opts.getInt("seed", 1),
+			he.scheme() != Scheme::CKKS);
+	MappedDataset data(opts.get("input"));
+	Columns cols;
+	cols.x = data.values("x");
+	cols.y = data.values("y");
+	cols.z = data.values("z");
+	return cols;
+}
+
+//All phases of one y(x+z) run, repeated under the benchmark harness
+void runPhases(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	string out = opts.get("out");
+
+	HEParams params = he.defaultParams();
+	Columns cols = inputColumns(he, opts);
+	vector<double> want = referenceYXZ(cols);
+
+	Benchmark bench(he.name(), argc, argv);
+	if (!out.empty())
+		bench.output(out + "/" + he.name() + ".json", out + "/" + he.name() + ".csv");
+
+	unique_ptr<KeyCache> cache;
+	if (opts.has("key-cache"))
+		cache.reset(new KeyCache(opts.get("key-cache")));
+
+	vector<double> got;
+	while (bench.next())
+		got = runYXZ(he, params, cols, bench, cache.get());
+	if (opts.has("result"))
+		writeDataset(opts.get("result") + "/" + he.name() + "-result.bin", NamedSpans(1, make_pair("e", ColumnSpan(got))));
+
+	cout << he.name() << ": " << cols.x.size() << " rows in " << he.slotCount() << " slots, " << he.threads()
+		<< " library threads, max error " << maxError(got, want) << endl;
+}
+
+//Slot-sized chunks of an arbitrarily long column set through a bounded pipeline
+void runStreaming(HEBackend &he, const Options &opts)
+{
+	size_t rows = (size_t)opts.getInt("rows", 10000000);
+	unsigned long seed = (unsigned long)opts.getInt("seed", 1);
+	size_t inflight = (size_t)opts.getInt("inflight", 2);
+
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	he.createContext(he.defaultParams());
+	generateKeys(he, yxzKeys(he));
+	double setup = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	GeneratedSource src(rows, seed, he.scheme() != Scheme::CKKS);
+	double err = 0;
+	StreamStats stats = runStream(he, src, inflight, [&](size_t, const Columns &in, const vector<double> &e) {
+		double d = maxError(e, referenceYXZ(in));
+		if (d > err)
+			err = d;
+	});
+
+	cout << he.name() << ": context and keys " << setup << " s, " << he.slotCount() << " slots per chunk, "
+		<< inflight << " chunks in flight" << endl;
+	stats.report(cout);
+	cout << "  max error " << err << endl;
+}
+
+//Per-ciphertext parallelism on the task pool at 1..N worker threads
+void runScaling(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	unsigned long seed = (unsigned long)opts.getInt("seed", 1);
+	int max_workers = (int)opts.getInt("workers", (long)thread::hardware_concurrency());
+	string out = opts.get("out");
+
+	he.createContext(he.defaultParams());
+	generateKeys(he, yxzKeys(he));
+
+	//default: eight chunks per worker at the largest count, so every worker has work
+	size_t rows = (size_t)opts.getInt("rows", (long)(8 * max_workers * he.slotCount()));
+	Columns cols = makeColumns(rows, seed, he.scheme() != Scheme::CKKS);
+	vector<double> want = referenceYXZ(cols);
+
+	ScalingReport scaling(he.name());
+	for (int t = 1; t <= max_workers; t++)
+	{
+		ThreadPool pool(t);
+		Benchmark bench(he.name() + " with " + to_string(t) + " workers", argc, argv);
+		bench.output("", "");
+		double err = 0;
+		while (bench.next())
+			err = maxError(runParallelYXZ(he, pool, cols, bench), want);
+		scaling.add(t, bench);
+		cout << "  max error " << err << endl;
+	}
+
+	scaling.print(cout);
+	if (!out.empty())
+	{
+		ofstream f((out + "/" + he.name() + "-scaling.csv").c_str());
+		scaling.writeCsv(f);
+	}
+}
+
+//The evaluation hot path, y(x+z) and decrypt on one encrypted chunk, with
+//object pooling off and on: time, heap allocations and new pool objects per
+//iteration. Warm-up runs fill the pool; the counts are from the last run.
+void runPool(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	size_t iterations = (size_t)max(opts.getInt("iterations", 100), 1L);
+	he.createContext(he.defaultParams());
+	generateKeys(he, yxzKeys(he));
+	Columns cols = inputColumns(he, opts);
+	size_t rows = min(cols.x.size(), he.slotCount());
+	cols.x.resize(rows);
+	cols.y.resize(rows);
+	cols.z.resize(rows);
+	vector<double> want = referenceYXZ(cols);
+
+	ostringstream table;
+	table << he.name() << ": y(x+z) and decrypt on " << rows << " rows, " << iterations << " iterations per run"
+		<< endl;
+	table << "  " << setw(8) << left << "pooling" << right << setw(12) << "s/iter" << setw(14) << "allocs/iter"
+		<< setw(14) << "bytes/iter" << setw(14) << "new objects" << setw(12) << "max error" << endl;
+	uint64_t pooled_allocs = 0;
+	for (int pooled = 0; pooled < 2; pooled++)
+	{
+		he.setObjectPooling(pooled != 0);
+		CipherPtr x = he.encrypt(he.encode(cols.x));
+		CipherPtr y = he.encrypt(he.encode(cols.y));
+		CipherPtr z = he.encrypt(he.encode(cols.z));
+		Benchmark bench(he.name() + (pooled ? " pooled" : " unpooled"), argc, argv);
+		bench.output("", "");
+		uint64_t allocs = 0, bytes = 0, created = 0;
+		CipherPtr e;
+		while (bench.next())
+		{
+			bench.start("eval");
+			//counted inside the phase: starting and stopping it allocates
+			uint64_t allocs0 = heap_counters.allocations.load(), bytes0 = heap_counters.allocated.load();
+			uint64_t created0 = he.objectPool().created;
+			for (size_t i = 0; i < iterations; i++)
+			{
+				e = evalYXZ(he, x, y, z);
+				PlainPtr p = he.decrypt(e);
+			}
+			allocs = heap_counters.allocations.load() - allocs0;
+			bytes = heap_counters.allocated.load() - bytes0;
+			created = he.objectPool().created - created0;
+			bench.stop("eval");
+		}
+		vector<double> got = he.decode(he.decrypt(e));
+		got.resize(rows);
+		table << "  " << setw(8) << left << (pooled ? "on" : "off") << right << setw(12)
+			<< bench.summary("eval").median / iterations << setw(14) << (double)allocs / iterations << setw(14)
+			<< (double)bytes / iterations << setw(14) << created << setw(12) << maxError(got, want) << endl;
+		if (pooled)
+			pooled_allocs = allocs;
+	}
+	if (!heapCounting())
+		table << "  (heap columns need a build with HE_COUNT_ALLOCATIONS)" << endl;
+	else if (pooled_allocs == 0)
+		table << "  steady state with pooling allocates nothing" << endl;
+	else
+		table << "  steady state with pooling still allocates " << (double)pooled_allocs / iterations
+			<< " times per iteration inside the library" << endl;
+	cout << table.str();
+}
+
+//A multi-chunk y(x+z) job phase by phase (every chunk encoded, then every
+//chunk encrypted, ...) against the same job as one async graph whose stages
+//overlap across chunks, on the same pool
+void runAsync(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	unsigned long seed = (unsigned long)opts.getInt("seed", 1);
+	size_t workers = (size_t)opts.getInt("workers", (long)thread::hardware_concurrency());
+	workers = workers ? workers : 1;
+	size_t inflight = (size_t)opts.getInt("inflight", (long)(2 * workers));
+
+	he.createContext(he.defaultParams());
+	generateKeys(he, yxzKeys(he));
+	size_t rows = (size_t)opts.getInt("rows", (long)(8 * workers * he.slotCount()));
+	Columns cols = makeColumns(rows, seed, he.scheme() != Scheme::CKKS);
+	vector<double> want = referenceYXZ(cols);
+
+	ThreadPool pool(workers);
+	Benchmark bench(he.name() + " async", argc, argv);
+	bench.output("", "");
+	double err_phased = 0, err_async = 0;
+	while (bench.next())
+	{
+		//runParallelYXZ times its own phases; "phased" is their total
+		bench.start("phased");
+		err_phased = maxError(runParallelYXZ(he, pool, cols, bench), want);
+		bench.stop("phased");
+		bench.start("pipelined");
+		err_async = maxError(runAsyncYXZ(he, pool, cols, inflight), want);
+		bench.stop("pipelined");
+	}
+
+	double a = bench.summary("phased").median, b = bench.summary("pipelined").median;
+	size_t chunks = (rows + he.slotCount() - 1) / he.slotCount();
+	ostringstream table;
+	table << he.name() << ": " << rows << " rows in " << chunks << " chunks on " << workers << " workers, "
+		<< inflight << " chunks in flight" << endl;
+	table << "  phased      " << a << " s, " << (a > 0 ? rows / a : 0) << " rows/s, max error " << err_phased << endl;
+	table << "  pipelined   " << b << " s, " << (b > 0 ? rows / b : 0) << " rows/s, max error " << err_async << endl;
+	table << "  speedup     " << (b > 0 ? a / b : 0) << "x" << endl;
+	cout << table.str();
+}
+
+//Library-internal parallelism: context, keygen, multiply and decrypt of one
+//ciphertext at 1..N library threads
+void runThreads(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	int max_threads = (int)opts.getInt("threads", (long)thread::hardware_concurrency());
+	string out = opts.get("out");
+	Columns cols = inputColumns(he, opts);
+	HEParams params = he.defaultParams();
+	he.setThreads(max_threads);
+	if (he.threads() == 1 && max_threads > 1)
+		cout << he.name() << " runs each operation on one thread in this build" << endl;
+
+	ScalingReport scaling(he.name() + " library threads");
+	for (int t = 1; t <= max_threads; t++)
+	{
+		he.setThreads(t);
+		Benchmark bench(he.name() + " with " + to_string(t) + " library threads", argc, argv);
+		bench.output("", "");
+		while (bench.next())
+		{
+			bench.start("context");
+			he.createContext(params);
+			bench.stop("context");
+
+			KeyRequirements keys = yxzKeys(he);
+			bench.start("keygen");
+			generateKeys(he, keys);
+			bench.stop("keygen");
+
+			CipherPtr x = he.encrypt(he.encode(cols.x)), y = he.encrypt(he.encode(cols.y));
+			bench.start("multiply");
+			CipherPtr p = he.multiply(x, y);
+			he.relinearize(p);
+			bench.stop("multiply");
+
+			bench.start("decrypt");
+			he.decrypt(p);
+			bench.stop("decrypt");
+		}
+		scaling.add(t, bench);
+	}
+
+	scaling.print(cout);
+	if (!out.empty())
+	{
+		ofstream f((out + "/" + he.name() + "-threads.csv").c_str());
+		scaling.writeCsv(f);
+	}
+}
+
+//Startup from scratch (entry evicted) against startup from the key cache
+void runStartup(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	KeyCache cache(opts.get("key-cache", "hekeys"));
+	HEParams params = he.defaultParams();
+
+	Benchmark bench(he.name() + " startup", argc, argv);
+	bench.output("", "");
+	while (bench.next())
+	{
+		cache.evict(he, params);
+		timedStartup(he, params, cache, bench);
+		timedStartup(he, params, cache, bench);
+	}
+
+	Summary cold = bench.summary("startup-cold");
+	Summary warm = bench.summary("startup-warm");
+	cout << he.name() << ": cold start " << cold.median << " s, warm start " << warm.median << " s ("
+		<< (warm.median > 0 ? cold.median / warm.median : 0) << "x) from " << cache.entry(he, params) << endl;
+}
+
+//Keygen time and evaluation-key bytes: every key the original programs made,
+//only the keys y(x+z) needs, and those keys generated on first use
+//Lazy keys must accumulate: rotations by 1, 2 and 3 each generate one key,
+//then all three run again and are checked against the clear rotation. A
+//backend whose key generation replaced the earlier keys fails here.
+string checkLazyRotations(HEBackend &he, const vector<double> &x)
+{
+	const int steps[] = { 1, 2, 3 };
+	size_t slots = he.slotCount(), row = he.rowSize();
+	vector<double> v(x);
+	v.resize(slots);
+	LazyKeyBackend lazy(he);
+	CipherPtr c = lazy.encrypt(lazy.encode(v));
+	double err = 0;
+	try
+	{
+		for (size_t i = 0; i < 3; i++)
+			lazy.rotate(c, steps[i]);
+		for (size_t i = 0; i < 3; i++)
+		{
+			vector<double> want(slots);
+			for (size_t j = 0; j < slots; j++)
+				want[j] = v[j - j % row + (j % row + steps[i]) % row];
+			err = max(err, maxError(lazy.decode(lazy.decrypt(lazy.rotate(c, steps[i]))), want));
+		}
+	}
+	catch (const exception &e)
+	{
+		return "rotations 1,2,3 failed once all keys existed: " + string(e.what());
+	}
+	return "rotations 1,2,3 generated one by one, max error " + to_string(err) +
+		(err > 0.5 ? " (earlier keys were lost)" : "");
+}
+
+void runKeys(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	HEParams params = he.defaultParams();
+	Columns cols = inputColumns(he, opts);
+
+	Benchmark bench(he.name() + " keys", argc, argv);
+	bench.output("", "");
+	size_t all_bytes = 0, circuit_bytes = 0, lazy_bytes = 0;
+	KeyRequirements all, needed;
+	string rotation_check;
+	while (bench.next())
+	{
+		he.createContext(params);
+		all = allKeys(he.rowSize());
+		bench.start("keygen-all");
+		generateKeys(he, all);
+		bench.stop("keygen-all");
+		all_bytes = he.keyBytes();
+
+		he.createContext(params);
+		needed = yxzKeys(he);
+		bench.start("keygen-circuit");
+		generateKeys(he, needed);
+		bench.stop("keygen-circuit");
+		circuit_bytes = he.keyBytes();
+
+		LazyKeyBackend lazy(he);
+		lazy.createContext(params);
+		Stopwatch sw;
+		lazy.keyGen();
+		PhaseSample keygen = sw.elapsed();
+		PlainPtr px = lazy.encode(cols.x), py = lazy.encode(cols.y), pz = lazy.encode(cols.z);
+		evalYXZ(lazy, lazy.encrypt(px), lazy.encrypt(py), lazy.encrypt(pz));
+		keygen.wall += lazy.keygenTime().wall;
+		keygen.cpu += lazy.keygenTime().cpu;
+		bench.record("keygen-lazy", keygen);
+		lazy_bytes = he.keyBytes();
+		rotation_check = checkLazyRotations(he, cols.x);
+	}
+
+	double t_all = bench.summary("keygen-all").median;
+	double t_circuit = bench.summary("keygen-circuit").median;
+	cout << he.name() << " evaluation keys:" << endl;
+	cout << "  all      " << all.describe() << ": " << t_all << " s, " << all_bytes << " bytes" << endl;
+	cout << "  circuit  " << needed.describe() << ": " << t_circuit << " s, " << circuit_bytes << " bytes" << endl;
+	cout << "  lazy     " << bench.summary("keygen-lazy").median << " s, " << lazy_bytes << " bytes" << endl;
+	cout << "  lazy rot " << rotation_check << endl;
+	cout << "  saved    " << t_all - t_circuit << " s keygen, " << (long long)all_bytes - (long long)circuit_bytes
+		<< " bytes of key memory" << endl;
+}
+
+//The x/y/z columns by variable name, for circuits from expr.h
+map<string, vector<double>> namedColumns(const Columns &cols)
+{
+	map<string, vector<double>> columns;
+	columns["x"] = cols.x;
+	columns["y"] = cols.y;
+	columns["z"] = cols.z;
+	return columns;
+}
+
+map<string, CipherPtr> encryptColumns(HEBackend &he, const map<string, vector<double>> &columns)
+{
+	map<string, CipherPtr> in;
+	for (map<string, vector<double>>::const_iterator it = columns.begin(); it != columns.end(); ++it)
+		in[it->first] = he.encrypt(he.encode(it->second));
+	return in;
+}
+
+//Evaluation keys circuit uses on he when the variables in pub are public
+KeyRequirements circuitKeys(const HEBackend &he, const Circuit &circuit, const set<string> &pub = set<string>())
+{
+	return analyzeKeys(he, [&](HEBackend &probe) {
+		map<string, CipherPtr> in;
+		map<string, vector<double>> clear;
+		vector<string> names = circuit.inputs();
+		for (size_t i = 0; i < names.size(); i++)
+			if (pub.count(names[i]))
+				clear[names[i]] = vector<double>();
+			else
+				in[names[i]] = probe.encrypt(probe.encode(vector<double>()));
+		circuit.run(probe, in, clear);
+	});
+}
+
+//"a,b,c" -> {a, b, c}
+set<string> splitList(const string &text)
+{
+	set<string> out;
+	istringstream in(text);
+	string item;
+	while (getline(in, item, ','))
+		if (!item.empty())
+			out.insert(item);
+	return out;
+}
+
+//A circuit over the x/y/z columns, evaluated as written and after optimization
+void runExpr(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	string text = opts.get("expr", "x*y+z*y");
+	ExprPtr e = parseExpr(text);
+	Circuit written = Circuit::lowerNaive(e);
+	Circuit optimized = compileExpr(e);
+
+	Columns cols = inputColumns(he, opts);
+	map<string, vector<double>> columns = namedColumns(cols);
+	vector<double> want = written.reference(columns);
+
+	he.createContext(he.defaultParams());
+	generateKeys(he, circuitKeys(he, written));
+	map<string, CipherPtr> in = encryptColumns(he, columns);
+
+	Benchmark bench(he.name() + " " + text, argc, argv);
+	bench.output("", "");
+	double err_written = 0, err_optimized = 0;
+	while (bench.next())
+	{
+		bench.start("eval-written");
+		CipherPtr a = written.run(he, in);
+		bench.stop("eval-written");
+		bench.start("eval-optimized");
+		CipherPtr b = optimized.run(he, in);
+		bench.stop("eval-optimized");
+		err_written = maxError(he.decode(he.decrypt(a)), want);
+		err_optimized = maxError(he.decode(he.decrypt(b)), want);
+	}
+
+	cout << he.name() << ": " << text << endl;
+	cout << "  as written  " << written.describe() << ": " << bench.summary("eval-written").median
+		<< " s, max error " << err_written << endl;
+	cout << "  optimized   " << optimized.describe() << ": " << bench.summary("eval-optimized").median
+		<< " s, max error " << err_optimized << endl;
+}
+
+//y(x+z) with the hand-picked parameters of the original programs against
+//the smallest parameters the planner finds for the same circuit and data
+void runPlan(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	Columns cols = inputColumns(he, opts);
+	vector<double> want = referenceYXZ(cols);
+
+	map<string, vector<double>> columns = namedColumns(cols);
+	Circuit circuit = Circuit::lower(parseExpr("y*(x+z)"));
+	PlanRequest req;
+	req.depth = circuit.depth();
+	req.slots = cols.x.size();
+	circuit.reference(columns, &req.maxValue);
+	req.precisionBits = (int)opts.getInt("precision", 20);
+	req.securityBits = (int)opts.getInt("security", 128);
+
+	HEParams current = he.defaultParams();
+	HEParams planned = planParams(he, req);
+
+	Benchmark hand(he.name() + " hand-picked", argc, argv);
+	Benchmark plan(he.name() + " planned", argc, argv);
+	hand.output("", "");
+	plan.output("", "");
+	double err_hand = 0, err_plan = 0;
+	while (hand.next())
+		err_hand = maxError(runYXZ(he, current, cols, hand), want);
+	while (plan.next())
+		err_plan = maxError(runYXZ(he, planned, cols, plan), want);
+
+	cout << he.name() << ": depth " << req.depth << ", " << req.slots << " slots, values up to " << req.maxValue << endl;
+	cout << "  hand-picked " << describeParams(he.name(), current) << ", max error " << err_hand << endl;
+	cout << "  planned     " << describeParams(he.name(), planned) << ", max error " << err_plan << endl;
+	double total_hand = 0, total_plan = 0;
+	for (size_t i = 0; i < hand.phases().size(); i++)
+	{
+		const string &phase = hand.phases()[i];
+		double a = hand.summary(phase).median, b = plan.summary(phase).median;
+		total_hand += a;
+		total_plan += b;
+		cout << "  " << setw(14) << left << phase << right << " " << a << " s -> " << b << " s ("
+			<< (b > 0 ? a / b : 0) << "x)" << endl;
+	}
+	cout << "  " << setw(14) << left << "total" << right << " " << total_hand << " s -> " << total_plan << " s ("
+		<< (total_plan > 0 ? total_hand / total_plan : 0) << "x)" << endl;
+}
+
+//One circuit under each relinearization and modulus-switching policy
+void runPolicy(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	string text = opts.get("expr", "y*(x+z)");
+	Circuit circuit = compileExpr(parseExpr(text));
+	Columns cols = inputColumns(he, opts);
+	map<string, vector<double>> columns = namedColumns(cols);
+	vector<double> want = circuit.reference(columns);
+
+	he.createContext(he.defaultParams());
+	generateKeys(he, circuitKeys(he, circuit));
+
+	int safety = (int)opts.getInt("safety", 10);
+	const EvalPolicy policies[] = {
+		EvalPolicy(EvalPolicy::Eager, false, safety), EvalPolicy(EvalPolicy::Lazy, false, safety),
+		EvalPolicy(EvalPolicy::Never, false, safety), EvalPolicy(EvalPolicy::Eager, true, safety),
+		EvalPolicy(EvalPolicy::Lazy, true, safety), EvalPolicy(EvalPolicy::Lazy, true, safety, true)
+	};
+
+	ostringstream table;
+	table << he.name() << ": " << text << " (" << circuit.describe() << ")" << endl;
+	table << "  " << setw(24) << left << "policy" << right << setw(12) << "eval s" << setw(12) << "decrypt s"
+		<< setw(12) << "bytes" << setw(8) << "budget" << setw(8) << "est." << setw(8) << "relin" << setw(8)
+		<< "switch" << setw(12) << "max error" << endl;
+	for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+	{
+		PolicyBackend pb(he, policies[i]);
+		map<string, CipherPtr> in = encryptColumns(pb, columns);
+
+		Benchmark bench(he.name() + " " + policies[i].describe(), argc, argv);
+		bench.output("", "");
+		CipherPtr result;
+		double err = 0;
+		size_t relin = 0, switches = 0;
+		while (bench.next())
+		{
+			relin = pb.relinCount();
+			switches = pb.switchCount();
+			bench.start("eval");
+			CipherPtr e = circuit.run(pb, in);
+			pb.finish(e);
+			bench.stop("eval");
+
+			bench.start("decrypt");
+			PlainPtr p = he.decrypt(unwrap<PolicyCiphertext>(e).c);
+			bench.stop("decrypt");
+			err = maxError(he.decode(p), want);
+			result = e;
+			relin = pb.relinCount() - relin;
+			switches = pb.switchCount() - switches;
+		}
+
+		table << "  " << setw(24) << left << policies[i].describe() << right << setw(12) << bench.summary("eval").median
+			<< setw(12) << bench.summary("decrypt").median << setw(12) << pb.ciphertextBytes(result) << setw(8)
+			<< pb.noiseBudget(result) << setw(8) << pb.estimateBudget(result, 0) << setw(8) << relin << setw(8)
+			<< switches << setw(12) << err << endl;
+	}
+	cout << table.str();
+}
+
+//A circuit with every column encrypted against the same circuit with the
+//--public columns left in the clear: evaluation keys, keygen and evaluation
+//time, and the noise left in the result
+void runPublic(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	string text = opts.get("expr", "y*(x+z)");
+	Circuit circuit = compileExpr(parseExpr(text));
+	Columns cols = inputColumns(he, opts);
+	map<string, vector<double>> columns = namedColumns(cols);
+	vector<double> want = circuit.reference(columns);
+	HEParams params = he.defaultParams();
+
+	const set<string> visibility[] = { set<string>(), splitList(opts.get("public", "y")) };
+	ostringstream table;
+	table << he.name() << ": " << text << " (" << circuit.describe() << ")" << endl;
+	table << "  " << setw(16) << left << "public" << right << setw(22) << "keys" << setw(12) << "key bytes"
+		<< setw(12) << "keygen s" << setw(12) << "eval s" << setw(8) << "budget" << setw(12) << "max error" << endl;
+	for (size_t v = 0; v < 2; v++)
+	{
+		const set<string> &pub = visibility[v];
+		Benchmark bench(he.name() + (pub.empty() ? " all encrypted" : " public " + opts.get("public", "y")), argc, argv);
+		bench.output("", "");
+		KeyRequirements keys;
+		size_t key_bytes = 0;
+		int budget = -1;
+		double err = 0;
+		while (bench.next())
+		{
+			he.createContext(params);
+			keys = circuitKeys(he, circuit, pub);
+			bench.start("keygen");
+			generateKeys(he, keys);
+			bench.stop("keygen");
+			key_bytes = he.keyBytes();
+
+			map<string, CipherPtr> in;
+			map<string, vector<double>> clear;
+			for (map<string, vector<double>>::const_iterator it = columns.begin(); it != columns.end(); ++it)
+				if (pub.count(it->first))
+					clear[it->first] = it->second;
+				else
+					in[it->first] = he.encrypt(he.encode(it->second));
+
+			bench.start("eval");
+			CipherPtr e = circuit.run(he, in, clear);
+			bench.stop("eval");
+			budget = he.noiseBudget(e);
+			err = maxError(he.decode(he.decrypt(e)), want);
+		}
+
+		string names;
+		for (set<string>::const_iterator it = pub.begin(); it != pub.end(); ++it)
+			names += (names.empty() ? "" : ",") + *it;
+		table << "  " << setw(16) << left << (names.empty() ? "none" : names) << right << setw(22) << keys.describe()
+			<< setw(12) << key_bytes << setw(12) << bench.summary("keygen").median << setw(12)
+			<< bench.summary("eval").median << setw(8) << budget << setw(12) << err << endl;
+	}
+	cout << table.str();
+}
+
+//Generated x/y/z columns written to the --input dataset, as float64 or, with
+//--scale, as int64 fixed point. Values are whole numbers unless --real is given,
+//so the same file suits every scheme.
+void runDataset(const Options &opts)
+{
+	Columns cols = makeColumns((size_t)opts.getInt("rows", 2760), (unsigned long)opts.getInt("seed", 1),
+		!opts.has("real"));
+	string path = opts.get("input", "columns.bin");
+	NamedSpans spans;
+	spans.push_back(make_pair("x", ColumnSpan(cols.x)));
+	spans.push_back(make_pair("y", ColumnSpan(cols.y)));
+	spans.push_back(make_pair("z", ColumnSpan(cols.z)));
+	if (opts.has("scale"))
+		writeDataset(path, spans, ValueType::Int64, opts.getDouble("scale", 1));
+	else
+		writeDataset(path, spans);
+	cout << "wrote " << cols.x.size() << " rows of x, y, z to " << path << endl;
+}
+
+//The encrypted dataset of he under the --encrypted directory
+string encryptedPath(const HEBackend &he, const Options &opts)
+{
+	return opts.get("encrypted", ".") + "/" + he.name() + ".ct";
+}
+
+//Encrypt the --input dataset once, in slot-sized chunks, under the keys in the
+//key cache, so runEvaluate can use it any number of times
+void runEncrypt(HEBackend &he, const Options &opts)
+{
+	KeyCache cache(opts.get("key-cache", "hekeys"));
+	HEParams params = he.defaultParams();
+	cache.setup(he, params, [&] { return yxzKeys(he); });
+
+	MappedDataset data(opts.get("input", "columns.bin"));
+	const char *names[] = { "x", "y", "z" };
+	vector<vector<double>> copies;
+	copies.reserve(3);
+	NamedSpans cols;
+	for (size_t i = 0; i < 3; i++)
+	{
+		//float64 columns are encoded from the mapping, int64 ones from an unscaled copy
+		if (data.type() == ValueType::Float64)
+		{
+			cols.push_back(make_pair(names[i], data.column(names[i])));
+			continue;
+		}
+		copies.push_back(data.values(names[i]));
+		cols.push_back(make_pair(names[i], ColumnSpan(copies.back())));
+	}
+
+	string path = encryptedPath(he, opts);
+	Stopwatch sw;
+	writeEncrypted(he, describeParams(he.name(), params), path, cols, opts.get("format", "binary"));
+	EncryptedDataset written(path);
+	cout << he.name() << ": encrypted " << data.rows() << " rows in " << written.chunks() << " chunks to " << path
+		<< " in " << sw.elapsed().wall << " s" << endl;
+}
+
+void addSample(PhaseSample &total, const Stopwatch &sw)
+{
+	PhaseSample s = sw.elapsed();
+	total.wall += s.wall;
+	total.cpu += s.cpu;
+}
+
+//y(x+z) over an encrypted dataset, chunk by chunk, with the cached keys it was
+//encrypted under. The decrypted result goes to --result; with --input it is
+//checked against the plaintext columns.
+void runEvaluate(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	KeyCache cache(opts.get("key-cache", "hekeys"));
+	HEParams params = he.defaultParams();
+	string path = encryptedPath(he, opts);
+	EncryptedDataset data(path);
+	if (data.params() != describeParams(he.name(), params) || !cache.contains(he, params))
+		throw runtime_error(path + " needs the cached keys for " + data.params());
+	cache.setup(he, params, [&] { return yxzKeys(he); });
+
+	Benchmark bench(he.name() + " evaluate", argc, argv);
+	bench.output("", "");
+	size_t slots = he.slotCount();
+	vector<double> e(data.rows());
+	while (bench.next())
+	{
+		PhaseSample load = { 0, 0 }, eval = { 0, 0 }, decrypt = { 0, 0 };
+		for (size_t k = 0; k < data.chunks(); k++)
+		{
+			Stopwatch t_load;
+			CipherPtr x = data.load(he, k, "x"), y = data.load(he, k, "y"), z = data.load(he, k, "z");
+			addSample(load, t_load);
+
+			Stopwatch t_eval;
+			CipherPtr r = evalYXZ(he, x, y, z);
+			addSample(eval, t_eval);
+
+			Stopwatch t_decrypt;
+			vector<double> v = he.decode(he.decrypt(r));
+			addSample(decrypt, t_decrypt);
+			size_t n = min(slots, data.rows() - k * slots);
+			copy(v.begin(), v.begin() + n, e.begin() + k * slots);
+		}
+		bench.record("load", load);
+		bench.record("eval", eval);
+		bench.record("decrypt", decrypt);
+	}
+
+	if (opts.has("result"))
+		writeDataset(opts.get("result") + "/" + he.name() + "-result.bin", NamedSpans(1, make_pair("e", ColumnSpan(e))));
+	cout << he.name() << ": " << data.rows() << " rows in " << data.chunks() << " " << data.format() << " chunks";
+	if (opts.has("input"))
+		cout << ", max error " << maxError(e, referenceYXZ(inputColumns(he, opts)));
+	cout << endl;
+}
+
+//Whole megabytes per second for bytes moved in seconds
+long long throughput(size_t bytes, double seconds)
+{
+	return seconds > 0 ? llround(bytes / seconds / 1e6) : 0;
+}
+
+//Size and speed of every ciphertext wire format: a fresh upload of x written
+//by encryptTo (so seeded formats take part) and the y(x+z) result written by
+//saveCiphertext, each read back and checked
+void runWire(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	Columns cols = inputColumns(he, opts);
+	vector<double> want = referenceYXZ(cols);
+
+	he.createContext(he.defaultParams());
+	generateKeys(he, yxzKeys(he));
+	PlainPtr px = he.encode(cols.x);
+	CipherPtr result = evalYXZ(he, he.encrypt(px), he.encrypt(he.encode(cols.y)), he.encrypt(he.encode(cols.z)));
+	double slots = (double)he.slotCount();
+
+	ostringstream table;
+	table << he.name() << " wire formats, " << he.slotCount() << " slots:" << endl;
+	table << "  " << setw(16) << left << "format" << right << setw(12) << "upload B" << setw(10) << "B/slot"
+		<< setw(14) << "enc+write s" << setw(12) << "read MB/s" << setw(12) << "result B" << setw(12) << "write MB/s"
+		<< setw(12) << "read MB/s" << setw(12) << "max error" << endl;
+	vector<string> formats = he.wireFormats();
+	for (size_t f = 0; f < formats.size(); f++)
+	{
+		const string &format = formats[f];
+		bool seeded = seededFormat(format);
+		Benchmark bench(he.name() + " " + format, argc, argv);
+		bench.output("", "");
+		size_t upload = 0, download = 0;
+		double err = 0;
+		while (bench.next())
+		{
+			ostringstream up;
+			bench.start("encrypt-write");
+			he.encryptTo(px, up, format);
+			bench.stop("encrypt-write");
+			string bytes = up.str();
+			upload = bytes.size();
+
+			istringstream in(bytes);
+			bench.start("read-upload");
+			CipherPtr fresh = he.loadCiphertext(in);
+			bench.stop("read-upload");
+			err = maxError(he.decode(he.decrypt(fresh)), cols.x);
+
+			//seeded formats exist only for fresh encryptions
+			if (seeded)
+				continue;
+			ostringstream down;
+			bench.start("write-result");
+			he.saveCiphertext(result, down, format);
+			bench.stop("write-result");
+			bytes = down.str();
+			download = bytes.size();
+
+			istringstream back(bytes);
+			bench.start("read-result");
+			CipherPtr e = he.loadCiphertext(back);
+			bench.stop("read-result");
+			double d = maxError(he.decode(he.decrypt(e)), want);
+			if (d > err)
+				err = d;
+		}
+
+		table << "  " << setw(16) << left << format << right << setw(12) << upload << setw(10) << setprecision(3)
+			<< upload / slots << setw(14) << bench.summary("encrypt-write").median << setw(12)
+			<< throughput(upload, bench.summary("read-upload").median);
+		if (seeded)
+			table << setw(12) << "-" << setw(12) << "-" << setw(12) << "-";
+		else
+			table << setw(12) << download << setw(12) << throughput(download, bench.summary("write-result").median)
+				<< setw(12) << throughput(download, bench.summary("read-result").median);
+		table << setw(12) << err << setprecision(6) << endl;
+	}
+	cout << table.str();
+}
+
+//Total sum, dot product x.y, mean and sliding-window sum of x, each with
+//log-step and baby-step/giant-step rotations: the rotation keys each set
+//needs, their keygen time and bytes, and the evaluation time they buy
+void runAggregate(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	Columns cols = inputColumns(he, opts);
+	size_t rows = cols.x.size();
+
+	//integer totals must fit the plaintext modulus; plan a larger one if not
+	double total = 0, dot = 0;
+	vector<double> xy(rows);
+	for (size_t i = 0; i < rows; i++)
+	{
+		xy[i] = cols.x[i] * cols.y[i];
+		total += fabs(cols.x[i]);
+		dot += fabs(xy[i]);
+	}
+	HEParams params = he.defaultParams();
+	if (he.scheme() != Scheme::CKKS && 2 * max(total, dot) >= (double)params.plainModulus)
+	{
+		PlanRequest req;
+		req.slots = rows;
+		req.maxValue = max(total, dot);
+		params = planParams(he, req);
+	}
+	he.createContext(params);
+	size_t slots = he.slotCount(), row = he.rowSize();
+	size_t window = min((size_t)opts.getInt("window", 16), row);
+
+	typedef function<CipherPtr(HEBackend &, const CipherPtr &, const CipherPtr &, RotationPlan)> Aggregate;
+	vector<string> names = { "sum", "dot", "mean", "window-" + to_string(window) };
+	vector<Aggregate> aggregates = {
+		[](HEBackend &h, const CipherPtr &x, const CipherPtr &, RotationPlan p) { return totalSum(h, x, p); },
+		[](HEBackend &h, const CipherPtr &x, const CipherPtr &y, RotationPlan p) { return dotProduct(h, x, y, p); },
+		[rows](HEBackend &h, const CipherPtr &x, const CipherPtr &, RotationPlan p) { return mean(h, x, rows, p); },
+		[window](HEBackend &h, const CipherPtr &x, const CipherPtr &, RotationPlan p) {
+			return windowSum(h, x, window, p);
+		},
+	};
+	vector<vector<double>> wants = { referenceWindow(cols.x, slots, row, row), referenceWindow(xy, slots, row, row),
+		referenceWindow(cols.x, slots, row, row), referenceWindow(cols.x, slots, row, window) };
+	if (he.scheme() == Scheme::CKKS)
+		for (size_t i = 0; i < slots; i++)
+			wants[2][i] /= rows;
+
+	ostringstream table;
+	table << he.name() << " aggregates, " << rows << " rows in rows of " << row << " slots:" << endl;
+	table << "  " << setw(12) << left << "aggregate" << setw(10) << "keys" << right << setw(10) << "rot keys"
+		<< setw(12) << "keygen s" << setw(14) << "key bytes" << setw(12) << "eval s" << setw(12) << "max error"
+		<< endl;
+	RotationPlan plans[] = { RotationPlan::LogStep, RotationPlan::BabyGiant };
+	for (size_t a = 0; a < aggregates.size(); a++)
+		for (size_t p = 0; p < 2; p++)
+		{
+			KeyRequirements keys = analyzeKeys(he, [&](HEBackend &probe) {
+				CipherPtr c = probe.encrypt(probe.encode(vector<double>()));
+				aggregates[a](probe, c, c, plans[p]);
+			});
+			Benchmark bench(he.name() + " " + names[a] + " " + describePlan(plans[p]), argc, argv);
+			bench.output("", "");
+			size_t key_bytes = 0;
+			double err = 0;
+			while (bench.next())
+			{
+				bench.start("keygen");
+				generateKeys(he, keys);
+				bench.stop("keygen");
+				key_bytes = he.keyBytes();
+				CipherPtr x = he.encrypt(he.encode(cols.x)), y = he.encrypt(he.encode(cols.y));
+				bench.start("eval");
+				CipherPtr out = aggregates[a](he, x, y, plans[p]);
+				bench.stop("eval");
+				err = maxError(he.decode(he.decrypt(out)), wants[a]);
+			}
+			table << "  " << setw(12) << left << names[a] << setw(10) << describePlan(plans[p]) << right
+				<< setw(10) << keys.rotations.size() << setprecision(3) << setw(12) << bench.summary("keygen").median
+				<< setw(14) << key_bytes << setw(12) << bench.summary("eval").median << setw(12) << err
+				<< setprecision(6) << endl;
+		}
+	cout << table.str();
+}
+
+//k rotations of one ciphertext, as k rotate calls and as one hoisted
+//rotateMany, for k = 1, 2, 4 ... up to --rotations
+void runHoist(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	Columns cols = inputColumns(he, opts);
+	he.createContext(he.defaultParams());
+	size_t most = min((size_t)opts.getInt("rotations", 16), he.rowSize() - 1);
+	vector<int> steps;
+	KeyRequirements keys;
+	for (size_t k = 1; k <= most; k++)
+	{
+		steps.push_back(normalizeRotation((long)k, he.rowSize()));
+		keys.rotations.insert(steps.back());
+	}
+	generateKeys(he, keys);
+	CipherPtr x = he.encrypt(he.encode(cols.x));
+
+	ostringstream table;
+	table << he.name() << " rotations of one ciphertext:" << endl;
+	table << "  " << setw(10) << "rotations" << setw(12) << "naive s" << setw(12) << "hoisted s" << setw(14)
+		<< "naive s/rot" << setw(14) << "hoisted s/rot" << setw(10) << "speedup" << setw(12) << "max diff" << endl;
+	for (size_t k = 1; k <= most; k *= 2)
+	{
+		vector<int> some(steps.begin(), steps.begin() + k);
+		Benchmark bench(he.name() + " " + to_string(k) + " rotations", argc, argv);
+		bench.output("", "");
+		double diff = 0;
+		while (bench.next())
+		{
+			vector<CipherPtr> naive;
+			bench.start("naive");
+			for (size_t i = 0; i < k; i++)
+				naive.push_back(he.rotate(x, some[i]));
+			bench.stop("naive");
+			bench.start("hoisted");
+			vector<CipherPtr> hoisted = he.rotateMany(x, some);
+			bench.stop("hoisted");
+			for (size_t i = 0; i < k; i++)
+				diff = max(diff, maxError(he.decode(he.decrypt(hoisted[i])), he.decode(he.decrypt(naive[i]))));
+		}
+		double a = bench.summary("naive").median, b = bench.summary("hoisted").median;
+		table << "  " << setprecision(3) << setw(10) << k << setw(12) << a << setw(12) << b << setw(14) << a / k
+			<< setw(14) << b / k << setw(10) << (b > 0 ? a / b : 0) << setw(12) << diff << setprecision(6) << endl;
+	}
+	cout << table.str();
+}
+
+//"a,b,c" -> {a, b, c} as numbers, in order
+vector<long> splitNumbers(const string &text)
+{
+	vector<long> out;
+	istringstream in(text);
+	string item;
+	while (getline(in, item, ','))
+		if (!item.empty())
+			out.push_back(strtol(item.c_str(), 0, 0));
+	return out;
+}
+
+//SEAL chains as their prime sizes, PALISADE ones as their depth
+string describeChain(const HEParams &p)
+{
+	if (p.coeffBits.empty())
+		return "depth " + to_string(p.depth);
+	string out;
+	for (size_t i = 0; i < p.coeffBits.size(); i++)
+		out += (i ? "," : "") + to_string(p.coeffBits[i]);
+	return out;
+}
+
+//y(x+z) under the hand-picked CKKS parameters and every swept scale, chain and
+//ring: encode-to-decode latency against the max/mean/RMS error over all slots.
+//* marks the frontier, where no faster set is as accurate.
+void runPrecision(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	if (he.scheme() != Scheme::CKKS)
+	{
+		cout << he.name() << ": precision mode is for CKKS backends" << endl;
+		return;
+	}
+	//2048 rows fit every ring from 4096 up, so all rings see the same data
+	Columns cols = opts.has("rows") || opts.has("input") ? inputColumns(he, opts)
+		: makeColumns(2048, (unsigned long)opts.getInt("seed", 1), false);
+	vector<double> want = referenceYXZ(cols);
+
+	PlanRequest req;
+	req.depth = 1;
+	req.slots = cols.x.size();
+	req.maxValue = 0;
+	for (size_t i = 0; i < want.size(); i++)
+		req.maxValue = max(req.maxValue, max(fabs(want[i]), max(fabs(cols.x[i] + cols.z[i]), fabs(cols.y[i]))));
+	req.securityBits = (int)opts.getInt("security", 128);
+
+	vector<long> rings = splitNumbers(opts.get("rings", "4096,8192,16384,32768"));
+	vector<long> scales = splitNumbers(opts.get("scales", "20,25,30,35,40,45,50"));
+	vector<long> levels = splitNumbers(opts.get("levels", "0,1"));
+	vector<HEParams> candidates(1, he.defaultParams());
+	vector<HEParams> swept = ckksCandidates(he, req, vector<size_t>(rings.begin(), rings.end()),
+		vector<int>(scales.begin(), scales.end()), vector<int>(levels.begin(), levels.end()));
+	candidates.insert(candidates.end(), swept.begin(), swept.end());
+
+	const char *phases[] = { "encode", "encrypt", "eval", "decrypt", "decode" };
+	vector<PrecisionPoint> points;
+	vector<string> failures;
+	bool hand_ok = false;
+	for (size_t c = 0; c < candidates.size(); c++)
+	{
+		Benchmark bench(he.name() + " " + describeParams(he.name(), candidates[c]), argc, argv);
+		bench.output("", "");
+		PrecisionPoint p;
+		p.params = candidates[c];
+		try
+		{
+			vector<double> got;
+			while (bench.next())
+				got = runYXZ(he, candidates[c], cols, bench);
+			p.error = errorStats(got, want);
+		}
+		catch (const exception &e)
+		{
+			failures.push_back(describeChain(candidates[c]) + " scale " + to_string(candidates[c].scaleBits) + " n "
+				+ to_string(candidates[c].ringDim) + ": " + e.what());
+			continue;
+		}
+		p.ring = 2 * he.slotCount();
+		p.seconds = 0;
+		for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++)
+			p.seconds += bench.summary(phases[i]).median;
+		points.push_back(p);
+		hand_ok = hand_ok || c == 0;
+	}
+	markFrontier(points);
+
+	ostringstream table;
+	table << he.name() << ": y(x+z) over " << cols.x.size() << " slots, values up to " << req.maxValue
+		<< "; error as log2 of the absolute error" << endl;
+	table << "  " << setw(8) << "ring" << "  " << setw(20) << left << "chain" << right << setw(7) << "scale"
+		<< setw(12) << "latency s" << setw(10) << "max" << setw(10) << "mean" << setw(10) << "rms" << endl;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		const PrecisionPoint &p = points[i];
+		table << "  " << setw(8) << p.ring << "  " << setw(20) << left << describeChain(p.params) << right << setw(7)
+			<< p.params.scaleBits << setprecision(3) << setw(12) << p.seconds << fixed << setprecision(1) << setw(10)
+			<< errorBits(p.error.max) << setw(10) << errorBits(p.error.mean) << setw(10) << errorBits(p.error.rms)
+			<< defaultfloat << setprecision(6) << (p.frontier ? "  *" : "") << (i == 0 && hand_ok ? "  hand-picked" : "") << endl;
+	}
+	for (size_t i = 0; i < failures.size(); i++)
+		table << "  failed " << failures[i] << endl;
+	cout << table.str();
+}
+
+//Coefficients of a degree-d test polynomial from the seed: CKKS gets
+//c_i in [-1, 1) / (i + 1), integer schemes c_i in -3..3
+vector<double> polyCoefficients(size_t degree, unsigned long seed, bool integer)
+{
+	vector<double> c(degree + 1);
+	uint64_t key = streamKey(seed, ColumnZ) ^ degree;
+	for (size_t i = 0; i <= degree; i++)
+	{
+		double u = (double)(mix64(key + i * GoldenGamma) >> 11) / 9007199254740992.0;
+		c[i] = integer ? floor(u * 7) - 3 : (2 * u - 1) / (i + 1);
+	}
+	if (c[degree] == 0)
+		c[degree] = 1;
+	return c;
+}
+
+//p(x) for each --degrees d, evaluated by power tree and by Paterson-Stockmeyer
+//with the best baby step, each under parameters planned for its own depth.
+//CKKS takes x in [-1, 1); integer schemes take x in 0..24 and compare mod t.
+void runPoly(HEBackend &he, const Options &opts, int argc, char **argv)
+{
+	unsigned long seed = (unsigned long)opts.getInt("seed", 1);
+	bool integer = he.scheme() != Scheme::CKKS;
+	Columns cols = inputColumns(he, opts);
+	vector<double> x = cols.x;
+	if (!integer)
+		for (size_t i = 0; i < x.size(); i++)
+			x[i] = x[i] / 12.5 - 1;
+	vector<long> degrees = splitNumbers(opts.get("degrees", "8,16,32"));
+
+	ostringstream table;
+	table << he.name() << ": p(x) over " << x.size() << " slots" << endl;
+	table << "  " << setw(6) << "degree" << "  " << setw(12) << left << "method" << right << setw(7) << "depth"
+		<< setw(7) << "mul" << setw(8) << "scalar" << "  " << setw(28) << left << "chain" << right << setw(8) << "slots"
+		<< setw(12) << "eval s" << setw(12) << "max error" << endl;
+	for (size_t d = 0; d < degrees.size(); d++)
+	{
+		size_t degree = (size_t)max(degrees[d], 1L);
+		vector<double> coeffs = polyCoefficients(degree, seed, integer);
+		const PolyPlan plans[] = { PolyPlan(degree + 1), planPoly(he.scheme(), coeffs) };
+		for (size_t p = 0; p < 2; p++)
+		{
+			if (p == 1 && plans[1].powerTree(degree))
+				continue;
+			PolyCost cost = polyCost(he.scheme(), coeffs, plans[p]);
+
+			//CKKS intermediates stay within the powers of |x| <= 1 and the
+			//sums of |c_i|; integer schemes wrap mod t, so any t will do
+			PlanRequest req;
+			req.depth = max(cost.depth, 1);
+			req.slots = x.size();
+			req.maxValue = 1;
+			for (size_t i = 0; i < coeffs.size(); i++)
+				req.maxValue += fabs(coeffs[i]);
+			if (integer)
+				req.maxValue = 65536;
+			req.precisionBits = (int)opts.getInt("precision", 20);
+			HEParams params = planParams(he, req);
+
+			Benchmark bench(he.name() + " degree " + to_string(degree) + " " + plans[p].describe(degree), argc, argv);
+			bench.output("", "");
+			double err = 0;
+			try
+			{
+				he.createContext(params);
+				generateKeys(he, analyzeKeys(he, [&](HEBackend &probe) {
+					evalPoly(probe, probe.encrypt(probe.encode(vector<double>())), coeffs, plans[p]);
+				}));
+				CipherPtr cx = he.encrypt(he.encode(x));
+				while (bench.next())
+				{
+					bench.start("eval");
+					CipherPtr out = evalPoly(he, cx, coeffs, plans[p]);
+					bench.stop("eval");
+					vector<double> got = he.decode(he.decrypt(out));
+					got.resize(x.size());
+					err = integer ? maxErrorMod(got, referencePolyMod(x, coeffs, params.plainModulus), params.plainModulus)
+						: maxError(got, referencePoly(x, coeffs));
+				}
+			}
+			catch (const exception &e)
+			{
+				table << "  " << setw(6) << degree << "  " << setw(12) << left << plans[p].describe(degree) << right
+					<< " failed: " << e.what() << endl;
+				continue;
+			}
+			table << "  " << setw(6) << degree << "  " << setw(12) << left << plans[p].describe(degree) << right
+				<< setw(7) << cost.depth << setw(7) << cost.multiplications << setw(8) << cost.scalars << "  "
+				<< setw(28) << left << (params.m ? "m " + to_string(params.m) + ", " + to_string(params.bits) + " bits"
+					: describeChain(params))
+				<< right << setw(8) << he.slotCount() << setw(12) << bench.summary("eval").median << setw(12) << err
+				<< endl;
+		}
+	}
+	cout << table.str();
+}
+
+int main(int argc, char **argv)
+{
+	Options opts(argc, argv);
+	string which = opts.get("backend", "all");
+	string mode = opts.get("mode", "phases");
+	//every Benchmark rewrites the trace as it finishes; this covers the rest
+	if (opts.has("trace"))
+		traceOpen(opts.get("trace"));
+
+	if (mode == "dataset")
+	{
+		runDataset(opts);
+		return 0;
+	}
+
+	vector<string> names;
+	if (which == "all")
+		names = availableBackends();
+	else
+		names.push_back(which);
+
+	if (names.empty())
+	{
+		cout << "No backends in this build; install SEAL, PALISADE or HElib and reconfigure." << endl;
+		return 0;
+	}
+
+	for (size_t b = 0; b < names.size(); b++)
+	{
+		unique_ptr<HEBackend> he = makeBackend(names[b]);
+		if (opts.has("threads") && mode != "threads")
+			he->setThreads((size_t)opts.getInt("threads", 1));
+		if (opts.get("object-pool", "on") == "off")
+			he->setObjectPooling(false);
+		if (mode == "threads")
+			runThreads(*he, opts, argc, argv);
+		else if (mode == "pool")
+			runPool(*he, opts, argc, argv);
+		else if (mode == "poly")
+			runPoly(*he, opts, argc, argv);
+		else if (mode == "async")
+			runAsync(*he, opts, argc, argv);
+		else if (mode == "encrypt")
+			runEncrypt(*he, opts);
+		else if (mode == "evaluate")
+			runEvaluate(*he, opts, argc, argv);
+		else if (mode == "public")
+			runPublic(*he, opts, argc, argv);
+		else if (mode == "precision")
+			runPrecision(*he, opts, argc, argv);
+		else if (mode == "hoist")
+			runHoist(*he, opts, argc, argv);
+		else if (mode == "aggregate")
+			runAggregate(*he, opts, argc, argv);
+		else if (mode == "wire")
+			runWire(*he, opts, argc, argv);
+		else if (mode == "stream")
+			runStreaming(*he, opts);
+		else if (mode == "policy")
+			runPolicy(*he, opts, argc, argv);
+		else if (mode == "plan")
+			runPlan(*he, opts, argc, argv);
+		else if (mode == "expr")
+			runExpr(*he, opts, argc, argv);
+		else if (mode == "keys")
+			runKeys(*he, opts, argc, argv);
+		else if (mode == "startup")
+			runStartup(*he, opts, argc, argv);
+		else if (mode == "scaling")
+			runScaling(*he, opts, argc, argv);
+		else if (mode == "phases")
+			runPhases(*he, opts, argc, argv);
+		else
+		{
+			cerr << "unknown --mode " << mode << "; valid modes: phases, stream, scaling, startup, keys, expr, plan, "
+				<< "policy, wire, public, dataset, encrypt, evaluate, aggregate, hoist, precision, threads, async, "
+				<< "poly, pool" << endl;
+			return 1;
+		}
+	}
+	traceFlush();
+	return 0;
+}
@@ -0,0 +1,244 @@
+/***************************************/
+/* Evaluation client                   */
+/* Generates the keys, uploads the     */
+/* public and evaluation keys to an    */
+/* heserver, then streams encrypted    */
+/* x/y/z chunks with at most           */
+/* --inflight awaiting a result while  */
+/* decrypting and checking results as  */
+/* they return.                        */
+/*                                     */
+/* heclient [--backend NAME]           */
+/*          [--socket unix:PATH|       */
+/*                    tcp:PORT]        */
+/*          [--rows N] [--seed S]      */
+/*          [--expr TEXT]              */
+/*          [--format NAME]            */
+/*          [--result-format NAME]     */
+/*          [--inflight K]             */
+/*          [--threads N]              */
+/*          [--trace FILE]             */
+/***************************************/
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "backends.h"
+#include "benchmark.h"
+#include "expr.h"
+#include "key_cache.h"
+#include "keys.h"
+#include "options.h"
+#include "service.h"
+#include "stream.h"
+#include "trace.h"
+
+using namespace std;
+
+typedef chrono::steady_clock clk;
+
+//A chunk sent and not yet answered
+struct Pending
+{
+	clk::time_point start;
+	map<string, vector<double>> columns;
+};
+
+int main(int argc, char **argv)
+{
+	Options opts(argc, argv);
+	vector<string> available = availableBackends();
+	if (available.empty())
+	{
+		cout << "No backends in this build; install SEAL, PALISADE or HElib and reconfigure." << endl;
+		return 0;
+	}
+	string address = opts.get("socket", "tcp:7700");
+	string text = opts.get("expr", "y*(x+z)");
+	string format = opts.get("format", "binary"), result_format = opts.get("result-format", "binary");
+	//at least one chunk in flight, as BoundedQueue clamps its capacity
+	long window_size = opts.getInt("inflight", 4);
+	size_t inflight = window_size > 0 ? (size_t)window_size : 1;
+
+	if (opts.has("trace"))
+		traceOpen(opts.get("trace"));
+	unique_ptr<HEBackend> he = makeBackend(opts.get("backend", available[0]));
+	if (opts.has("threads"))
+		he->setThreads((size_t)opts.getInt("threads", 1));
+	size_t lib_threads = he->threads();
+	HEParams params = he->defaultParams();
+	checkFormat(*he, format);
+	if (seededFormat(result_format))
+		throw invalid_argument(result_format + " is for fresh encryptions; pick another --result-format");
+	Circuit circuit = compileExpr(parseExpr(text));
+	vector<string> names = circuit.inputs();
+	for (size_t i = 0; i < names.size(); i++)
+		if (names[i] != "x" && names[i] != "y" && names[i] != "z")
+			throw invalid_argument("the client streams columns x, y and z, not " + names[i]);
+
+	he->createContext(params);
+	Stopwatch keygen;
+	generateKeys(*he, analyzeKeys(*he, [&](HEBackend &probe) {
+		map<string, CipherPtr> in;
+		for (size_t i = 0; i < names.size(); i++)
+			in[names[i]] = probe.encrypt(probe.encode(vector<double>()));
+		circuit.run(probe, in);
+	}));
+	double keygen_s = keygen.elapsed().wall;
+
+	Connection conn(openSocket(address, false));
+	ostringstream hello;
+	writeString(hello, he->name());
+	writeString(hello, describeParams(he->name(), params));
+	writeString(hello, text);
+	writeString(hello, format);
+	writeString(hello, result_format);
+	conn.send(Message::Hello, hello.str());
+	conn.expect(Message::Hello);
+
+	//the secret key never leaves this process
+	string dir = makeTempDir("heclient");
+	he->savePublicKeys(dir);
+	string keys = packDirectory(dir);
+	filesystem::remove_all(dir);
+	uint64_t before_keys = conn.sent();
+	Stopwatch upload;
+	conn.send(Message::Keys, keys);
+	conn.expect(Message::Keys);
+	double upload_s = upload.elapsed().wall;
+	uint64_t key_wire = conn.sent();
+
+	GeneratedSource src((size_t)opts.getInt("rows", 100000), (unsigned long)opts.getInt("seed", 1),
+		he->scheme() != Scheme::CKKS);
+	map<uint64_t, Pending> pending;
+	mutex pending_mutex;
+	condition_variable window;
+	bool stop = false;
+	exception_ptr failed;
+
+	//encode, encrypt and send on this thread; receive, decrypt and check below
+	clk::time_point begin = clk::now();
+	thread sender([&] {
+		try
+		{
+			he->setThreads(lib_threads);
+			for (uint64_t id = 0;; id++)
+			{
+				Columns in;
+				clk::time_point start = clk::now();
+				if (src.read(he->slotCount(), in) == 0)
+					break;
+				{
+					unique_lock<mutex> lock(pending_mutex);
+					window.wait(lock, [&] { return pending.size() < inflight || stop; });
+					if (stop)
+						break;
+				}
+				Pending p;
+				p.columns["x"] = in.x;
+				p.columns["y"] = in.y;
+				p.columns["z"] = in.z;
+				ostringstream msg;
+				writeU64(msg, id);
+				for (size_t i = 0; i < names.size(); i++)
+				{
+					ostringstream blob;
+					he->encryptTo(he->encode(p.columns.at(names[i])), blob, format);
+					writeString(msg, blob.str());
+				}
+				p.start = start;
+				{
+					lock_guard<mutex> lock(pending_mutex);
+					pending[id] = move(p);
+				}
+				conn.send(Message::Chunk, msg.str());
+			}
+			conn.send(Message::End, "");
+		}
+		catch (...)
+		{
+			failed = current_exception();
+			try
+			{
+				conn.send(Message::End, "");
+			}
+			catch (const exception &)
+			{
+			}
+		}
+	});
+
+	vector<double> latency;
+	size_t rows = 0;
+	double err = 0;
+	try
+	{
+		for (;;)
+		{
+			Message type;
+			string payload;
+			if (!conn.receive(type, payload) || type == Message::End)
+				break;
+			if (type == Message::Error)
+				throw runtime_error("server: " + payload);
+			PayloadReader msg(move(payload));
+			uint64_t id = msg.u64();
+			istringstream blob(msg.str());
+			vector<double> got = he->decode(he->decrypt(he->loadCiphertext(blob)));
+
+			Pending p;
+			{
+				lock_guard<mutex> lock(pending_mutex);
+				map<uint64_t, Pending>::iterator it = pending.find(id);
+				if (it == pending.end())
+					throw runtime_error("result for unknown chunk " + to_string(id));
+				p = move(it->second);
+				pending.erase(it);
+			}
+			window.notify_one();
+			latency.push_back(chrono::duration<double>(clk::now() - p.start).count());
+
+			vector<double> want = circuit.reference(p.columns);
+			got.resize(want.size());
+			err = max(err, maxError(got, want));
+			rows += want.size();
+		}
+	}
+	catch (...)
+	{
+		{
+			lock_guard<mutex> lock(pending_mutex);
+			stop = true;
+		}
+		window.notify_all();
+		sender.join();
+		throw;
+	}
+	sender.join();
+	if (failed)
+		rethrow_exception(failed);
+	double wall = chrono::duration<double>(clk::now() - begin).count();
+
+	Summary lat = summarize(latency);
+	cout << he->name() << " via " << address << ": " << text << ", " << format << " uploads, " << result_format
+		<< " results, " << inflight << " in flight, " << lib_threads << " library threads" << endl;
+	cout << "  keys       keygen " << keygen_s << " s, " << key_wire - before_keys << " bytes uploaded in " << upload_s
+		<< " s" << endl;
+	cout << "  stream     " << rows << " rows in " << latency.size() << " chunks, " << wall << " s, "
+		<< (wall > 0 ? rows / wall : 0) << " rows/s" << endl;
+	cout << "  latency    median " << lat.median << " s, p95 " << lat.p95 << " s, p99 " << lat.p99
+		<< " s per chunk (encode to decode)" << endl;
+	cout << "  wire       " << conn.sent() - key_wire << " bytes up, " << conn.received() << " bytes down, "
+		<< (latency.empty() ? 0 : (conn.sent() - key_wire + conn.received()) / latency.size())
+		<< " bytes per chunk" << endl;
+	cout << "  max error  " << err << endl;
+	traceFlush();
+	return 0;
+}
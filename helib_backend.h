@@ -0,0 +1,397 @@
+/***************************************/
+/* HElib adapter for HEBackend         */
+/* BGV over EncryptedArray slots.      */
+/* Results go into pooled objects      */
+/* (pool.h).                           */
+/***************************************/
+#ifndef HELIB_BACKEND_H
+#define HELIB_BACKEND_H
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <helib/helib.h>
+#include <helib/matmul.h>
+#include <NTL/BasicThreadPool.h>
+#include "he_backend.h"
+#include "trace.h"
+
+struct HelibPlaintext : HEPlaintext
+{
+	NTL::ZZX p;
+};
+
+struct HelibCiphertext : HECiphertext
+{
+	explicit HelibCiphertext(const helib::PubKey &pk) : c(pk) {}
+	helib::Ctxt c;
+};
+
+class HelibBackend : public HEBackend
+{
+public:
+	//Pooled ciphertexts refer to the public key they were made with, so the
+	//pools are emptied whenever the context or keys change
+	explicit HelibBackend(Scheme s)
+		: sch(s), rotation_keys(false), ciphers([this] { return new HelibCiphertext(publicKey()); }),
+		  plains([] { return new HelibPlaintext; })
+	{
+		if (s != Scheme::BGV)
+			throw std::invalid_argument("the HElib adapter implements BGV only");
+	}
+
+	std::string name() const { return "helib-bgv"; }
+	Scheme scheme() const { return sch; }
+
+	HEParams defaultParams() const
+	{
+		HEParams p(sch);
+		p.plainModulus = 55001;
+		p.m = 32109;
+		p.bits = 300;
+		p.c = 2;
+		p.r = 1;
+		return p;
+	}
+
+	void createContext(const HEParams &params)
+	{
+		this->params = params;
+		clearPools();
+		secret_key.reset();
+		public_only.reset();
+		context.reset(helib::ContextBuilder<helib::BGV>()
+						  .m(params.m)
+						  .p(params.plainModulus)
+						  .r(params.r)
+						  .bits(params.bits)
+						  .c(params.c)
+						  .buildPtr());
+	}
+
+	void keyGen()
+	{
+		clearPools();
+		public_only.reset();
+		secret_key.reset(new helib::SecKey(*context));
+		secret_key->GenSecKey();
+		rotation_keys = false;
+	}
+
+	//GenSecKey already adds the s^2 -> s matrix HElib relinearizes with
+	void relinKeyGen() {}
+
+	//HElib builds key-switching matrices per hypercube generator rather than per
+	//offset, so the first request generates all of them and later ones are free
+	void rotationKeyGen(const std::vector<int> &steps)
+	{
+		if (steps.empty() || rotation_keys)
+			return;
+		needSecret();
+		helib::addSome1DMatrices(*secret_key);
+		rotation_keys = true;
+	}
+
+	//Key-switching matrices live in the public key
+	size_t keyBytes() const
+	{
+		std::ostringstream out;
+		publicKey().writeTo(out);
+		return (size_t)out.tellp();
+	}
+
+	//The public key, including every key-switching matrix, is part of the secret key
+	void saveKeys(const std::string &dir) const
+	{
+		std::ofstream ctx(dir + "/context.bin", std::ios::binary);
+		context->writeTo(ctx);
+		std::ofstream sk(dir + "/secret.bin", std::ios::binary);
+		secret_key->writeTo(sk);
+	}
+
+	void savePublicKeys(const std::string &dir) const
+	{
+		std::ofstream ctx(dir + "/context.bin", std::ios::binary);
+		context->writeTo(ctx);
+		std::ofstream pk(dir + "/public.bin", std::ios::binary);
+		publicKey().writeTo(pk);
+	}
+
+	//Either directory layout: secret.bin from saveKeys or public.bin from savePublicKeys
+	void loadKeys(const std::string &dir, const HEParams &params)
+	{
+		this->params = params;
+		std::ifstream ctx(dir + "/context.bin", std::ios::binary);
+		std::ifstream sk(dir + "/secret.bin", std::ios::binary);
+		std::ifstream pk(dir + "/public.bin", std::ios::binary);
+		if (!ctx || (!sk && !pk))
+			throw std::runtime_error("cannot read HElib keys from " + dir);
+
+		clearPools();
+		secret_key.reset();
+		public_only.reset();
+		context.reset(helib::Context::readPtrFrom(ctx));
+		if (sk)
+			secret_key.reset(new helib::SecKey(helib::SecKey::readFrom(sk, *context)));
+		else
+			public_only.reset(new helib::PubKey(helib::PubKey::readFrom(pk, *context)));
+		rotation_keys = publicKey().keySWlist().size() > 1;
+	}
+
+	size_t slotCount() const { return context->getEA().size(); }
+
+	//EncryptedArray packs from a full slot vector, filled straight from the view
+	PlainPtr encode(ColumnSpan values)
+	{
+		HE_TRACE_SCOPE(trace, "encode");
+		HE_TRACE_ARG(trace, "values", std::min(values.size, slotCount()));
+		std::vector<long> v(slotCount(), 0);
+		for (size_t i = 0; i < values.size && i < v.size(); i++)
+			v[i] = std::lround(values.data[i]);
+
+		std::shared_ptr<HelibPlaintext> out = plains.acquire(0);
+		context->getEA().encode(out->p, v);
+		return out;
+	}
+
+	//Slots hold residues mod p; map them back to the signed range
+	std::vector<double> decode(const PlainPtr &plain)
+	{
+		HE_TRACE_SCOPE(trace, "decode");
+		std::vector<long> v;
+		context->getEA().decode(v, unwrap<HelibPlaintext>(plain).p);
+
+		long p = (long)params.plainModulus;
+		std::vector<double> out(v.size());
+		for (size_t i = 0; i < v.size(); i++)
+			out[i] = (double)(v[i] > p / 2 ? v[i] - p : v[i]);
+		return out;
+	}
+
+	CipherPtr encrypt(const PlainPtr &plain)
+	{
+		const helib::PubKey &public_key = publicKey();
+		std::shared_ptr<HelibCiphertext> out = ciphers.acquire(context->getCtxtPrimes().card());
+		HE_TRACE_SCOPE(trace, "encrypt");
+		public_key.Encrypt(out->c, unwrap<HelibPlaintext>(plain).p);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	PlainPtr decrypt(const CipherPtr &cipher)
+	{
+		needSecret();
+		std::shared_ptr<HelibPlaintext> out = plains.acquire(0);
+		HE_TRACE_SCOPE(trace, "decrypt");
+		HE_TRACE_ONLY(traceCipher(trace, unwrap<HelibCiphertext>(cipher).c));
+		secret_key->Decrypt(out->p, unwrap<HelibCiphertext>(cipher).c);
+		return out;
+	}
+
+	CipherPtr add(const CipherPtr &a, const CipherPtr &b)
+	{
+		HE_TRACE_SCOPE(trace, "add");
+		std::shared_ptr<HelibCiphertext> out = copyOf(unwrap<HelibCiphertext>(a).c);
+		out->c += unwrap<HelibCiphertext>(b).c;
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	CipherPtr multiply(const CipherPtr &a, const CipherPtr &b)
+	{
+		HE_TRACE_SCOPE(trace, "multiply");
+		std::shared_ptr<HelibCiphertext> out = copyOf(unwrap<HelibCiphertext>(a).c);
+		out->c.multLowLvl(unwrap<HelibCiphertext>(b).c);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	CipherPtr addPlain(const CipherPtr &a, const PlainPtr &b)
+	{
+		HE_TRACE_SCOPE(trace, "add-plain");
+		std::shared_ptr<HelibCiphertext> out = copyOf(unwrap<HelibCiphertext>(a).c);
+		out->c.addConstant(unwrap<HelibPlaintext>(b).p);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	CipherPtr multiplyPlain(const CipherPtr &a, const PlainPtr &b)
+	{
+		HE_TRACE_SCOPE(trace, "multiply-plain");
+		std::shared_ptr<HelibCiphertext> out = copyOf(unwrap<HelibCiphertext>(a).c);
+		out->c.multByConstant(unwrap<HelibPlaintext>(b).p);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	//Traces the ciphertext it was given
+	void relinearize(CipherPtr &cipher)
+	{
+		HE_TRACE_SCOPE(trace, "relinearize");
+		HE_TRACE_ONLY(traceCipher(trace, unwrap<HelibCiphertext>(cipher).c));
+		unwrap<HelibCiphertext>(cipher).c.reLinearize();
+	}
+
+	//HElib picks its own primes to drop before each multiplication
+	void rescale(CipherPtr &) {}
+
+	CipherPtr rotate(const CipherPtr &cipher, int steps)
+	{
+		HE_TRACE_SCOPE(trace, "rotate");
+		std::shared_ptr<HelibCiphertext> out = copyOf(unwrap<HelibCiphertext>(cipher).c);
+		HE_TRACE_ARG(trace, "steps", steps);
+		context->getEA().rotate(out->c, -steps);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	//With one native hypercube dimension every rotation is a single automorphism,
+	//so the precon decomposes the ciphertext once for all of them; other
+	//hypercubes rotate one at a time
+	std::vector<CipherPtr> rotateMany(const CipherPtr &cipher, const std::vector<int> &steps)
+	{
+		const helib::EncryptedArray &ea = context->getEA();
+		if (ea.dimension() != 1 || !ea.nativeDimension(0))
+			return HEBackend::rotateMany(cipher, steps);
+		const helib::Ctxt &c = unwrap<HelibCiphertext>(cipher).c;
+		std::shared_ptr<helib::GeneralAutomorphPrecon> precon = helib::buildGeneralAutomorphPrecon(c, 0, ea);
+		long n = ea.sizeOfDimension(0);
+		std::vector<CipherPtr> out;
+		for (size_t i = 0; i < steps.size(); i++)
+		{
+			long k = ((-steps[i]) % n + n) % n;
+			if (!k)
+			{
+				out.push_back(copyOf(c));
+				continue;
+			}
+			//the automorph result is assigned straight into a pooled object;
+			//copying the input there first would only be overwritten
+			std::shared_ptr<HelibCiphertext> r = ciphers.acquire(c.getPrimeSet().card());
+			r->c = *precon->automorph(k);
+			out.push_back(r);
+		}
+		return out;
+	}
+
+	size_t ciphertextBytes(const CipherPtr &cipher) const
+	{
+		std::ostringstream out;
+		unwrap<HelibCiphertext>(cipher).c.writeTo(out);
+		return (size_t)out.tellp();
+	}
+
+	size_t ciphertextMemory(const CipherPtr &cipher) const
+	{
+		const helib::Ctxt &c = unwrap<HelibCiphertext>(cipher).c;
+		return c.size() * c.getPrimeSet().card() * context->getPhiM() * sizeof(long);
+	}
+
+	//The public encryption key is a two-part ciphertext; key-switching
+	//matrices (relinearization and rotation) store their b columns
+	std::vector<std::pair<std::string, size_t>> keyMemory() const
+	{
+		std::vector<std::pair<std::string, size_t>> out;
+		size_t secret = 0, switching = 0;
+		for (size_t i = 0; secret_key && i < secret_key->sKeys.size(); i++)
+			secret += crtMemory(secret_key->sKeys[i]);
+		const std::vector<helib::KeySwitch> &list = publicKey().keySWlist();
+		for (size_t i = 0; i < list.size(); i++)
+			for (size_t j = 0; j < list[i].b.size(); j++)
+				switching += crtMemory(list[i].b[j]);
+		out.push_back(std::make_pair("secret", secret));
+		out.push_back(std::make_pair("keyswitch", switching));
+		return out;
+	}
+
+	//NTL's thread pool, which HElib splits CRT primes across; NTL built
+	//without NTL_THREAD_BOOST stubs both to a single thread
+	size_t threads() const { return (size_t)NTL::AvailableThreads(); }
+	void setThreads(size_t n) { NTL::SetNumThreads((long)std::max<size_t>(n, 1)); }
+
+	void setObjectPooling(bool on)
+	{
+		ciphers.setEnabled(on);
+		plains.setEnabled(on);
+	}
+
+	PoolStats objectPool() const { return ciphers.stats() + plains.stats(); }
+
+	//Bits of modulus left above the noise
+	int noiseBudget(const CipherPtr &cipher) const
+	{
+		return (int)unwrap<HelibCiphertext>(cipher).c.capacity();
+	}
+
+	//HElib tracks a noise bound in every ciphertext, so capacity needs no secret key
+	int estimateBudget(const CipherPtr &cipher, int) const { return noiseBudget(cipher); }
+
+	void saveCiphertext(const CipherPtr &cipher, std::ostream &out, const std::string &format) const
+	{
+		checkFormat(*this, format);
+		unwrap<HelibCiphertext>(cipher).c.writeTo(out);
+	}
+
+	CipherPtr loadCiphertext(std::istream &in)
+	{
+		std::shared_ptr<HelibCiphertext> out = ciphers.acquire(context->getCtxtPrimes().card());
+		out->c.read(in);
+		//results usually arrive below the top level
+		ciphers.setLevel(out, out->c.getPrimeSet().card());
+		return out;
+	}
+
+protected:
+	//The secret key doubles as the public key unless only the public one was loaded
+	const helib::PubKey &publicKey() const
+	{
+		return secret_key ? *secret_key : *public_only;
+	}
+
+	void needSecret() const
+	{
+		if (!secret_key)
+			throw std::logic_error("only public keys are loaded");
+	}
+
+	//A pooled ciphertext holding c; assignment reuses the parts' storage
+	std::shared_ptr<HelibCiphertext> copyOf(const helib::Ctxt &c)
+	{
+		std::shared_ptr<HelibCiphertext> out = ciphers.acquire(c.getPrimeSet().card());
+		out->c = c;
+		return out;
+	}
+
+	void clearPools()
+	{
+		ciphers.clear();
+		plains.clear();
+	}
+
+	size_t crtMemory(const helib::DoubleCRT &p) const
+	{
+		return p.getIndexSet().card() * context->getPhiM() * sizeof(long);
+	}
+
+#ifdef HE_TRACE
+	//Level as primes above the last, the way SEAL counts its chain index
+	static void traceCipher(TraceScope &trace, const helib::Ctxt &c)
+	{
+		HE_TRACE_ARG(trace, "level", c.getPrimeSet().card() - 1);
+		HE_TRACE_ARG(trace, "size", c.size());
+		HE_TRACE_ARG(trace, "capacity", c.bitCapacity());
+	}
+#endif
+
+	Scheme sch;
+	HEParams params;
+	std::unique_ptr<helib::Context> context;
+	std::unique_ptr<helib::SecKey> secret_key;
+	std::unique_ptr<helib::PubKey> public_only;
+	bool rotation_keys;
+	ObjectPool<HelibCiphertext> ciphers;
+	ObjectPool<HelibPlaintext> plains;
+};
+
+#endif
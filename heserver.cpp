@@ -0,0 +1,191 @@
+/***************************************/
+/* Evaluation server                   */
+/* Holds public and evaluation keys    */
+/* only. Each connection names its     */
+/* backend and circuit, uploads its    */
+/* keys, then streams chunks; a reader */
+/* queues them and a pool of workers   */
+/* evaluates and answers each as soon  */
+/* as it is done.                      */
+/*                                     */
+/* heserver [--socket unix:PATH|       */
+/*                    tcp:PORT]        */
+/*          [--workers N] [--queue K]  */
+/*          [--threads N] [--once]     */
+/*          [--max-message MB]         */
+/*          [--trace FILE]             */
+/***************************************/
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include "backends.h"
+#include "expr.h"
+#include "key_cache.h"
+#include "options.h"
+#include "service.h"
+#include "stream.h"
+#include "trace.h"
+
+using namespace std;
+
+//One client session: handshake, keys, then chunks until End
+void serve(Connection &conn, const Options &opts)
+{
+	PayloadReader hello(conn.expect(Message::Hello));
+	string backend = hello.str(), params_text = hello.str(), text = hello.str();
+	string format = hello.str(), result_format = hello.str();
+
+	unique_ptr<HEBackend> he = makeBackend(backend);
+	if (opts.has("threads"))
+		he->setThreads((size_t)opts.getInt("threads", 1));
+	size_t lib_threads = he->threads();
+	HEParams params = he->defaultParams();
+	if (describeParams(he->name(), params) != params_text)
+		throw runtime_error("unsupported parameters " + params_text);
+	checkFormat(*he, format);
+	checkFormat(*he, result_format);
+	Circuit circuit = compileExpr(parseExpr(text));
+	vector<string> names = circuit.inputs();
+	conn.send(Message::Hello, "");
+
+	//the keys only pass through disk because loadKeys reads a directory
+	string keys = conn.expect(Message::Keys);
+	string dir = makeTempDir("heserver");
+	try
+	{
+		unpackDirectory(keys, dir);
+		he->loadKeys(dir, params);
+	}
+	catch (...)
+	{
+		filesystem::remove_all(dir);
+		throw;
+	}
+	filesystem::remove_all(dir);
+	conn.send(Message::Keys, "");
+
+	typedef chrono::steady_clock clk;
+	BoundedQueue<string> queue((size_t)opts.getInt("queue", 8));
+	size_t workers = (size_t)opts.getInt("workers", thread::hardware_concurrency());
+	atomic<size_t> chunks(0);
+	atomic<long long> busy_ns(0);
+	exception_ptr failed;
+	mutex failed_mutex;
+	vector<thread> pool;
+	for (size_t w = 0; w < (workers ? workers : 1); w++)
+		pool.push_back(thread([&] {
+			try
+			{
+				he->setThreads(lib_threads);
+				string job;
+				while (queue.pop(job))
+				{
+					clk::time_point t0 = clk::now();
+					PayloadReader in(move(job));
+					uint64_t id = in.u64();
+					map<string, CipherPtr> vars;
+					for (size_t i = 0; i < names.size(); i++)
+					{
+						istringstream blob(in.str());
+						vars[names[i]] = he->loadCiphertext(blob);
+					}
+					CipherPtr e = circuit.run(*he, vars);
+					ostringstream blob, out;
+					he->saveCiphertext(e, blob, result_format);
+					writeU64(out, id);
+					writeString(out, blob.str());
+					busy_ns += chrono::duration_cast<chrono::nanoseconds>(clk::now() - t0).count();
+					conn.send(Message::Result, out.str());
+					chunks++;
+				}
+			}
+			catch (const exception &e)
+			{
+				//tell the client now: it may be waiting for results, not sending
+				lock_guard<mutex> lock(failed_mutex);
+				if (!failed)
+				{
+					failed = current_exception();
+					conn.sendError(e.what());
+				}
+				queue.close();
+			}
+		}));
+
+	//End, a closed connection or a failed worker stops the intake
+	clk::time_point begin = clk::now();
+	try
+	{
+		Message type;
+		string payload;
+		while (conn.receive(type, payload) && type == Message::Chunk)
+			if (!queue.push(move(payload)))
+				break;
+	}
+	catch (...)
+	{
+		queue.close();
+		for (size_t w = 0; w < pool.size(); w++)
+			pool[w].join();
+		throw;
+	}
+	queue.close();
+	for (size_t w = 0; w < pool.size(); w++)
+		pool[w].join();
+	if (failed)
+		rethrow_exception(failed);
+	conn.send(Message::End, "");
+
+	double wall = chrono::duration<double>(clk::now() - begin).count();
+	cout << he->name() << " " << text << ": " << chunks << " chunks in " << wall << " s with " << pool.size()
+		<< " workers of " << lib_threads << " library threads, " << busy_ns / 1e9 << " s evaluating; " << conn.received() << " bytes in, " << conn.sent()
+		<< " bytes out" << endl;
+}
+
+int main(int argc, char **argv)
+{
+	Options opts(argc, argv);
+	string address = opts.get("socket", "tcp:7700");
+	if (availableBackends().empty())
+	{
+		cout << "No backends in this build; install SEAL, PALISADE or HElib and reconfigure." << endl;
+		return 0;
+	}
+
+	//the trace file is rewritten after every session
+	if (opts.has("trace"))
+		traceOpen(opts.get("trace"));
+	uint64_t max_payload = opts.has("max-message") ? (uint64_t)opts.getInt("max-message", 0) << 20
+		: DefaultMaxPayload;
+	int listener = openSocket(address, true);
+	cout << "listening on " << address << endl;
+	do
+	{
+		int fd = accept(listener, 0, 0);
+		if (fd < 0)
+			continue;
+		Connection conn(fd, max_payload);
+		try
+		{
+			serve(conn, opts);
+		}
+		catch (const exception &e)
+		{
+			//a failed worker has already told the client
+			cerr << "session failed: " << e.what() << endl;
+			conn.sendError(e.what());
+		}
+		traceFlush();
+	} while (!opts.has("once"));
+	close(listener);
+	return 0;
+}
@@ -0,0 +1,156 @@
+/***************************************/
+/* On-disk key and context cache       */
+/* One directory per backend and       */
+/* parameter set, named by a hash of   */
+/* the parameters. A warm start reads  */
+/* the context and keys back instead   */
+/* of regenerating them.               */
+/*                                     */
+/* The cache holds secret keys: keep   */
+/* it on a private, local disk.        */
+/***************************************/
+#ifndef KEY_CACHE_H
+#define KEY_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include "he_backend.h"
+#include "keys.h"
+
+//Canonical text form of everything that changes the generated keys
+inline std::string describeParams(const std::string &backend, const HEParams &p)
+{
+	std::ostringstream out;
+	out << backend << " scheme=" << (int)p.scheme << " n=" << p.ringDim << " t=" << p.plainModulus
+		<< " tbits=" << p.plainBits << " q=";
+	for (size_t i = 0; i < p.coeffBits.size(); i++)
+		out << (i ? "," : "") << p.coeffBits[i];
+	out << " scale=" << p.scaleBits << " depth=" << p.depth << " sec=" << p.securityBits << " m=" << p.m
+		<< " bits=" << p.bits << " c=" << p.c << " r=" << p.r;
+	return out.str();
+}
+
+//64-bit FNV-1a
+inline uint64_t hashString(const std::string &s)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		h ^= (unsigned char)s[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+//Evaluation keys held by a cache entry: "relin 0|1" then "rot" and the offsets
+inline void writeKeys(const std::string &path, const KeyRequirements &keys)
+{
+	std::ofstream out(path.c_str());
+	out << "relin " << keys.relin << "\nrot";
+	for (std::set<int>::const_iterator it = keys.rotations.begin(); it != keys.rotations.end(); ++it)
+		out << " " << *it;
+	out << "\n";
+}
+
+inline KeyRequirements readKeys(const std::string &path)
+{
+	KeyRequirements keys;
+	std::ifstream in(path.c_str());
+	std::string word;
+	int k;
+	in >> word >> keys.relin >> word;
+	while (in >> k)
+		keys.rotations.insert(k);
+	return keys;
+}
+
+class KeyCache
+{
+public:
+	explicit KeyCache(const std::string &dir) : root(dir) {}
+
+	std::string entry(const HEBackend &he, const HEParams &params) const
+	{
+		char hex[17];
+		std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hashString(describeParams(he.name(), params)));
+		return (root / (he.name() + "-" + hex)).string();
+	}
+
+	bool contains(const HEBackend &he, const HEParams &params) const
+	{
+		return std::filesystem::is_directory(entry(he, params));
+	}
+
+	//Reload the context and keys when cached, otherwise create the context and
+	//generate the keys. needed() is asked once a context exists; evaluation keys
+	//missing from a cached entry are generated and the entry is rewritten.
+	//Returns true on a warm start.
+	bool setup(HEBackend &he, const HEParams &params, const std::function<KeyRequirements()> &needed)
+	{
+		std::string dir = entry(he, params);
+		if (!std::filesystem::is_directory(dir))
+		{
+			he.createContext(params);
+			KeyRequirements req = needed();
+			generateKeys(he, req);
+			store(he, params, req);
+			return false;
+		}
+
+		he.loadKeys(dir, params);
+		KeyRequirements have = readKeys(dir + "/keys.txt");
+		KeyRequirements want = needed();
+		bool changed = false;
+		if (want.relin && !have.relin)
+		{
+			he.relinKeyGen();
+			have.relin = changed = true;
+		}
+
+		std::vector<int> missing;
+		for (std::set<int>::const_iterator it = want.rotations.begin(); it != want.rotations.end(); ++it)
+			if (!have.rotations.count(*it))
+				missing.push_back(*it);
+		if (!missing.empty())
+		{
+			he.rotationKeyGen(missing);
+			have.rotations.insert(missing.begin(), missing.end());
+			changed = true;
+		}
+
+		if (changed)
+			store(he, params, have);
+		return true;
+	}
+
+	//Write into a temporary directory and rename, so readers never see half an entry
+	void store(const HEBackend &he, const HEParams &params, const KeyRequirements &keys)
+	{
+		std::string dir = entry(he, params);
+		std::string tmp = dir + ".tmp";
+		std::filesystem::remove_all(tmp);
+		std::filesystem::create_directories(tmp);
+		std::filesystem::permissions(tmp, std::filesystem::perms::owner_all);
+		he.saveKeys(tmp);
+
+		std::ofstream(tmp + "/params.txt") << describeParams(he.name(), params) << std::endl;
+		writeKeys(tmp + "/keys.txt", keys);
+		std::filesystem::remove_all(dir);
+		std::filesystem::rename(tmp, dir);
+	}
+
+	void evict(const HEBackend &he, const HEParams &params)
+	{
+		std::filesystem::remove_all(entry(he, params));
+	}
+
+private:
+	std::filesystem::path root;
+};
+
+#endif
@@ -0,0 +1,280 @@
+/***************************************/
+/* Circuit-driven evaluation keys      */
+/* KeyProbe dry-runs a circuit on      */
+/* placeholder ciphertexts to find the */
+/* relinearization and rotation keys   */
+/* it really uses; LazyKeyBackend      */
+/* generates each of them on first     */
+/* use instead of up front.            */
+/***************************************/
+#ifndef KEYS_H
+#define KEYS_H
+
+#include <functional>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+#include "he_backend.h"
+
+struct KeyRequirements
+{
+	bool relin;
+	std::set<int> rotations;
+
+	KeyRequirements() : relin(false) {}
+
+	std::string describe() const
+	{
+		std::ostringstream out;
+		out << "relin=" << relin << " rot=";
+		for (std::set<int>::const_iterator it = rotations.begin(); it != rotations.end(); ++it)
+			out << (it == rotations.begin() ? "" : ",") << *it;
+		return out.str();
+	}
+};
+
+//Rotations are cyclic in a row, so steps and steps +- rowSize share a key;
+//use the offset of smallest magnitude
+inline int normalizeRotation(long steps, size_t rowSize)
+{
+	long row = (long)rowSize;
+	long k = ((steps % row) + row) % row;
+	return (int)(k > row / 2 ? k - row : k);
+}
+
+//Everything the original programs generated up front: relinearization keys and
+//rotations by every power of two in both directions (EvalSumKeyGen, addSome1DMatrices)
+inline KeyRequirements allKeys(size_t rowSize)
+{
+	KeyRequirements req;
+	req.relin = true;
+	for (size_t k = 1; k < rowSize; k *= 2)
+	{
+		req.rotations.insert((int)k);
+		req.rotations.insert(-(int)k);
+	}
+	return req;
+}
+
+//Public/secret keys plus exactly the evaluation keys in req
+inline void generateKeys(HEBackend &he, const KeyRequirements &req)
+{
+	he.keyGen();
+	if (req.relin)
+		he.relinKeyGen();
+	if (!req.rotations.empty())
+		he.rotationKeyGen(std::vector<int>(req.rotations.begin(), req.rotations.end()));
+}
+
+//Backend that evaluates nothing and records which evaluation keys a circuit touches
+class KeyProbe : public HEBackend
+{
+public:
+	KeyProbe(Scheme s, size_t slots, size_t rowSize) : sch(s), slots(slots), row(rowSize) {}
+
+	const KeyRequirements &requirements() const { return req; }
+
+	std::string name() const { return "probe"; }
+	Scheme scheme() const { return sch; }
+	HEParams defaultParams() const { return HEParams(sch); }
+	void createContext(const HEParams &) {}
+	void keyGen() {}
+	void relinKeyGen() {}
+	void rotationKeyGen(const std::vector<int> &) {}
+	void saveKeys(const std::string &) const {}
+	void savePublicKeys(const std::string &) const {}
+	void loadKeys(const std::string &, const HEParams &) {}
+	size_t slotCount() const { return slots; }
+	size_t rowSize() const { return row; }
+	size_t keyBytes() const { return 0; }
+	size_t ciphertextBytes(const CipherPtr &) const { return 0; }
+	size_t ciphertextMemory(const CipherPtr &) const { return 0; }
+	std::vector<std::pair<std::string, size_t>> keyMemory() const { return std::vector<std::pair<std::string, size_t>>(); }
+	void saveCiphertext(const CipherPtr &, std::ostream &, const std::string &) const {}
+	CipherPtr loadCiphertext(std::istream &) { return CipherPtr(new HECiphertext); }
+
+	PlainPtr encode(ColumnSpan) { return PlainPtr(new HEPlaintext); }
+	std::vector<double> decode(const PlainPtr &) { return std::vector<double>(slots); }
+	CipherPtr encrypt(const PlainPtr &) { return CipherPtr(new HECiphertext); }
+	PlainPtr decrypt(const CipherPtr &) { return PlainPtr(new HEPlaintext); }
+	CipherPtr add(const CipherPtr &, const CipherPtr &) { return CipherPtr(new HECiphertext); }
+	CipherPtr multiply(const CipherPtr &, const CipherPtr &) { return CipherPtr(new HECiphertext); }
+	CipherPtr addPlain(const CipherPtr &, const PlainPtr &) { return CipherPtr(new HECiphertext); }
+	CipherPtr multiplyPlain(const CipherPtr &, const PlainPtr &) { return CipherPtr(new HECiphertext); }
+	void relinearize(CipherPtr &) { req.relin = true; }
+	void rescale(CipherPtr &) {}
+
+	CipherPtr rotate(const CipherPtr &, int steps)
+	{
+		int k = normalizeRotation(steps, row);
+		if (k != 0)
+			req.rotations.insert(k);
+		return CipherPtr(new HECiphertext);
+	}
+
+private:
+	Scheme sch;
+	size_t slots;
+	size_t row;
+	KeyRequirements req;
+};
+
+//Keys used by circuit, found by running it once on a KeyProbe shaped like he.
+//he must already have a context, for its slot layout.
+inline KeyRequirements analyzeKeys(const HEBackend &he, const std::function<void(HEBackend &)> &circuit)
+{
+	KeyProbe probe(he.scheme(), he.slotCount(), he.rowSize());
+	circuit(probe);
+	return probe.requirements();
+}
+
+//Forwards to another backend and generates each evaluation key the first
+//time an operation needs it. keyGen() only creates the public/secret pair.
+//Generating a key rewrites the backend's key set, so it waits for every
+//relinearization and rotation in flight, which hold the key lock shared.
+class LazyKeyBackend : public HEBackend
+{
+public:
+	explicit LazyKeyBackend(HEBackend &inner) : he(inner)
+	{
+		keygen_time.wall = keygen_time.cpu = 0;
+	}
+
+	const KeyRequirements &generated() const { return req; }
+	//Time spent generating evaluation keys on demand
+	PhaseSample keygenTime() const { return keygen_time; }
+
+	std::string name() const { return he.name(); }
+	Scheme scheme() const { return he.scheme(); }
+	HEParams defaultParams() const { return he.defaultParams(); }
+
+	void createContext(const HEParams &params)
+	{
+		req = KeyRequirements();
+		keygen_time.wall = keygen_time.cpu = 0;
+		he.createContext(params);
+	}
+
+	void keyGen() { he.keyGen(); }
+	void relinKeyGen() { needRelin(); }
+	void rotationKeyGen(const std::vector<int> &steps)
+	{
+		for (size_t i = 0; i < steps.size(); i++)
+			needRotation(steps[i]);
+	}
+
+	void saveKeys(const std::string &dir) const { he.saveKeys(dir); }
+	void savePublicKeys(const std::string &dir) const { he.savePublicKeys(dir); }
+	void loadKeys(const std::string &dir, const HEParams &params) { he.loadKeys(dir, params); }
+	size_t slotCount() const { return he.slotCount(); }
+	size_t rowSize() const { return he.rowSize(); }
+	size_t keyBytes() const { return he.keyBytes(); }
+
+	PlainPtr encode(ColumnSpan values) { return he.encode(values); }
+	std::vector<double> decode(const PlainPtr &plain) { return he.decode(plain); }
+	CipherPtr encrypt(const PlainPtr &plain) { return he.encrypt(plain); }
+	PlainPtr decrypt(const CipherPtr &cipher) { return he.decrypt(cipher); }
+	CipherPtr add(const CipherPtr &a, const CipherPtr &b) { return he.add(a, b); }
+	CipherPtr multiply(const CipherPtr &a, const CipherPtr &b) { return he.multiply(a, b); }
+	CipherPtr addPlain(const CipherPtr &a, const PlainPtr &b) { return he.addPlain(a, b); }
+	CipherPtr multiplyPlain(const CipherPtr &a, const PlainPtr &b) { return he.multiplyPlain(a, b); }
+	void rescale(CipherPtr &cipher) { he.rescale(cipher); }
+	size_t ciphertextBytes(const CipherPtr &cipher) const { return he.ciphertextBytes(cipher); }
+	size_t ciphertextMemory(const CipherPtr &cipher) const { return he.ciphertextMemory(cipher); }
+	std::vector<std::pair<std::string, size_t>> keyMemory() const { return he.keyMemory(); }
+	size_t poolBytes() const { return he.poolBytes(); }
+	void setObjectPooling(bool on) { he.setObjectPooling(on); }
+	PoolStats objectPool() const { return he.objectPool(); }
+	size_t threads() const { return he.threads(); }
+	void setThreads(size_t n) { he.setThreads(n); }
+	int noiseBudget(const CipherPtr &cipher) const { return he.noiseBudget(cipher); }
+	int estimateBudget(const CipherPtr &cipher, int depth) const { return he.estimateBudget(cipher, depth); }
+	CipherPtr modSwitch(const CipherPtr &cipher) { return he.modSwitch(cipher); }
+	std::vector<std::string> wireFormats() const { return he.wireFormats(); }
+	void saveCiphertext(const CipherPtr &cipher, std::ostream &out, const std::string &format) const
+	{
+		he.saveCiphertext(cipher, out, format);
+	}
+	CipherPtr loadCiphertext(std::istream &in) { return he.loadCiphertext(in); }
+	void encryptTo(const PlainPtr &plain, std::ostream &out, const std::string &format) { he.encryptTo(plain, out, format); }
+
+	void relinearize(CipherPtr &cipher)
+	{
+		needRelin();
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		he.relinearize(cipher);
+	}
+
+	CipherPtr rotate(const CipherPtr &cipher, int steps)
+	{
+		int k = needRotation(steps);
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return he.rotate(cipher, k);
+	}
+
+	std::vector<CipherPtr> rotateMany(const CipherPtr &cipher, const std::vector<int> &steps)
+	{
+		std::vector<int> keyed(steps.size());
+		for (size_t i = 0; i < steps.size(); i++)
+			keyed[i] = needRotation(steps[i]);
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return he.rotateMany(cipher, keyed);
+	}
+
+private:
+	//Checked shared first, so calls whose key exists never queue behind each other
+	void needRelin()
+	{
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			if (req.relin)
+				return;
+		}
+		std::lock_guard<std::shared_mutex> lock(mutex);
+		if (req.relin)
+			return;
+		Stopwatch sw;
+		he.relinKeyGen();
+		addKeygenTime(sw);
+		req.relin = true;
+	}
+
+	//Returns the normalized offset, the one a key exists for
+	int needRotation(int steps)
+	{
+		int k = normalizeRotation(steps, he.rowSize());
+		if (k == 0)
+			return k;
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			if (req.rotations.count(k))
+				return k;
+		}
+		std::lock_guard<std::shared_mutex> lock(mutex);
+		if (req.rotations.count(k))
+			return k;
+		Stopwatch sw;
+		he.rotationKeyGen(std::vector<int>(1, k));
+		addKeygenTime(sw);
+		req.rotations.insert(k);
+		return k;
+	}
+
+	void addKeygenTime(const Stopwatch &sw)
+	{
+		PhaseSample s = sw.elapsed();
+		keygen_time.wall += s.wall;
+		keygen_time.cpu += s.cpu;
+	}
+
+	HEBackend &he;
+	std::shared_mutex mutex;   //exclusive while a key is generated
+	KeyRequirements req;
+	PhaseSample keygen_time;
+};
+
+#endif
@@ -0,0 +1,142 @@
+/***************************************/
+/* Memory instrumentation              */
+/* Peak RSS per phase from /proc, heap */
+/* bytes and allocation counts from    */
+/* the malloc hook in alloc_hook.cpp,  */
+/* and the growth of a library pool    */
+/* such as SEAL's MemoryManager.       */
+/*                                     */
+/* Phases are measured one at a time:  */
+/* the peak counters are process-wide. */
+/***************************************/
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <sys/resource.h>
+
+//Updated by alloc_hook.cpp; all zero when it is not linked in
+struct HeapCounters
+{
+	std::atomic<uint64_t> allocated;    //bytes ever allocated
+	std::atomic<uint64_t> allocations;
+	std::atomic<int64_t> live;          //bytes currently allocated
+	std::atomic<int64_t> peak;          //highest live since the last mark
+};
+
+inline HeapCounters heap_counters;
+
+//True when the build links the allocation hook (HE_COUNT_ALLOCATIONS on glibc)
+inline bool heapCounting()
+{
+#if defined(HE_COUNT_ALLOCATIONS) && defined(__GLIBC__)
+	return true;
+#else
+	return false;
+#endif
+}
+
+inline void countAllocation(size_t bytes)
+{
+	heap_counters.allocated.fetch_add(bytes, std::memory_order_relaxed);
+	heap_counters.allocations.fetch_add(1, std::memory_order_relaxed);
+	int64_t live = heap_counters.live.fetch_add((int64_t)bytes, std::memory_order_relaxed) + (int64_t)bytes;
+	int64_t peak = heap_counters.peak.load(std::memory_order_relaxed);
+	while (live > peak && !heap_counters.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+	{
+	}
+}
+
+inline void countRelease(size_t bytes)
+{
+	heap_counters.live.fetch_sub((int64_t)bytes, std::memory_order_relaxed);
+}
+
+//A "Vm...:  1234 kB" field of /proc/self/status in bytes, 0 when unavailable
+inline size_t procStatus(const std::string &field)
+{
+	std::ifstream in("/proc/self/status");
+	std::string key;
+	size_t kb;
+	while (in >> key)
+	{
+		if (key == field + ":" && in >> kb)
+			return kb * 1024;
+		in.ignore(256, '\n');
+	}
+	return 0;
+}
+
+//Highest resident set size since the last resetPeakRss (or process start)
+inline size_t peakRss()
+{
+	size_t hwm = procStatus("VmHWM");
+	if (hwm)
+		return hwm;
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return (size_t)ru.ru_maxrss * 1024;
+}
+
+//Linux 4.0+: restart the VmHWM high-water mark from the current RSS
+inline bool resetPeakRss()
+{
+	std::ofstream out("/proc/self/clear_refs");
+	out << "5" << std::endl;
+	return (bool)out;
+}
+
+struct MemorySample
+{
+	size_t peakRss;        //bytes, peak resident set during the phase
+	int64_t heapPeak;      //bytes, peak heap above the level at phase start
+	uint64_t allocated;    //bytes allocated during the phase
+	uint64_t allocations;
+	int64_t pool;          //bytes a library pool grew by during the phase
+};
+
+//Memory used between start() and stop(); pool reports a library pool's size
+class MemoryMeter
+{
+public:
+	MemoryMeter() : live0(0), allocated0(0), allocations0(0), pool0(0), rss_reset(false) {}
+
+	void start(const std::function<size_t()> &pool)
+	{
+		rss_reset = resetPeakRss();
+		live0 = heap_counters.live.load();
+		heap_counters.peak.store(live0);
+		allocated0 = heap_counters.allocated.load();
+		allocations0 = heap_counters.allocations.load();
+		pool0 = pool ? (int64_t)pool() : 0;
+	}
+
+	//Without a VmHWM reset the peak RSS is the process peak so far
+	MemorySample stop(const std::function<size_t()> &pool) const
+	{
+		//heap first: reading /proc allocates
+		MemorySample s;
+		s.heapPeak = heap_counters.peak.load() - live0;
+		s.allocated = heap_counters.allocated.load() - allocated0;
+		s.allocations = heap_counters.allocations.load() - allocations0;
+		s.pool = pool ? (int64_t)pool() - pool0 : 0;
+		s.peakRss = peakRss();
+		return s;
+	}
+
+	bool rssReset() const { return rss_reset; }
+
+private:
+	int64_t live0;
+	uint64_t allocated0;
+	uint64_t allocations0;
+	int64_t pool0;
+	bool rss_reset;
+};
+
+#endif
@@ -0,0 +1,32 @@
+/***************************************/
+/* OpenMP thread count for the         */
+/* PALISADE programs                   */
+/* PALISADE parallelizes inside each   */
+/* operation with OpenMP when built    */
+/* with it; --threads N caps the team, */
+/* otherwise OMP_NUM_THREADS or every  */
+/* core is used.                       */
+/***************************************/
+#ifndef OMP_THREADS_H
+#define OMP_THREADS_H
+
+#include <cstddef>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "options.h"
+
+//Applies --threads and returns the threads operations will use
+inline size_t applyOpenMPThreads(const Options &opts)
+{
+#ifdef _OPENMP
+	if (opts.has("threads"))
+		omp_set_num_threads((int)opts.getInt("threads", 1));
+	return (size_t)omp_get_max_threads();
+#else
+	(void)opts;
+	return 1;
+#endif
+}
+
+#endif
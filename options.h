@@ -0,0 +1,62 @@
+/***************************************/
+/* Command line options                */
+/* "--name value" and "--flag" pairs   */
+/* shared by every program             */
+/***************************************/
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <cstdlib>
+#include <string>
+#include <map>
+
+class Options
+{
+public:
+	Options(int argc, char **argv)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			if (arg.compare(0, 2, "--") != 0)
+				continue;
+
+			arg = arg.substr(2);
+			size_t eq = arg.find('=');
+			if (eq != std::string::npos)
+				values[arg.substr(0, eq)] = arg.substr(eq + 1);
+			else if (i + 1 < argc && std::string(argv[i + 1]).compare(0, 2, "--") != 0)
+				values[arg] = argv[++i];
+			else
+				values[arg] = "";
+		}
+	}
+
+	bool has(const std::string &name) const
+	{
+		return values.count(name) != 0;
+	}
+
+	std::string get(const std::string &name, const std::string &def = "") const
+	{
+		std::map<std::string, std::string>::const_iterator it = values.find(name);
+		return it == values.end() ? def : it->second;
+	}
+
+	long getInt(const std::string &name, long def) const
+	{
+		std::map<std::string, std::string>::const_iterator it = values.find(name);
+		return (it == values.end() || it->second.empty()) ? def : std::strtol(it->second.c_str(), 0, 0);
+	}
+
+	double getDouble(const std::string &name, double def) const
+	{
+		std::map<std::string, std::string>::const_iterator it = values.find(name);
+		return (it == values.end() || it->second.empty()) ? def : std::strtod(it->second.c_str(), 0);
+	}
+
+private:
+	std::map<std::string, std::string> values;
+};
+
+#endif
@@ -0,0 +1,460 @@
+/***************************************/
+/* PALISADE adapter for HEBackend      */
+/* BFVrns, BGVrns and CKKS over        */
+/* CryptoContext<DCRTPoly>             */
+/***************************************/
+#ifndef PALISADE_BACKEND_H
+#define PALISADE_BACKEND_H
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <fstream>
+#include <map>
+#include <sstream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "palisade.h"
+#include "ciphertext-ser.h"
+#include "cryptocontext-ser.h"
+#include "pubkeylp-ser.h"
+#include "scheme/bfvrns/bfvrns-ser.h"
+#include "scheme/bgvrns/bgvrns-ser.h"
+#include "scheme/ckks/ckks-ser.h"
+#include "he_backend.h"
+#include "trace.h"
+
+struct PalisadePlaintext : HEPlaintext
+{
+	lbcrypto::Plaintext p;
+};
+
+struct PalisadeCiphertext : HECiphertext
+{
+	lbcrypto::Ciphertext<lbcrypto::DCRTPoly> c;
+};
+
+//No object pool: every Eval call returns a ciphertext the library has just
+//allocated, so there is no storage to write a result into
+class PalisadeBackend : public HEBackend
+{
+public:
+	explicit PalisadeBackend(Scheme s) : sch(s) {}
+
+	std::string name() const
+	{
+		return sch == Scheme::CKKS ? "palisade-ckks" : sch == Scheme::BGV ? "palisade-bgv" : "palisade-bfv";
+	}
+
+	Scheme scheme() const { return sch; }
+
+	HEParams defaultParams() const
+	{
+		HEParams p(sch);
+		if (sch == Scheme::BFV)
+		{
+			p.plainModulus = 536903681;
+			p.depth = 2;
+		}
+		else if (sch == Scheme::BGV)
+		{
+			p.plainModulus = 65537;
+			p.depth = 2;
+		}
+		else
+		{
+			p.scaleBits = 50;
+			p.depth = 1;
+		}
+		return p;
+	}
+
+	void createContext(const HEParams &params)
+	{
+		using namespace lbcrypto;
+		this->params = params;
+		SecurityLevel sec = params.securityBits >= 256 ? HEStd_256_classic
+			: params.securityBits >= 192 ? HEStd_192_classic : HEStd_128_classic;
+		//a ring dimension below what PALISADE needs for its own modulus chain is
+		//rejected; ringDim is a lower bound, so let PALISADE choose in that case
+		try
+		{
+			cc = generate(params, sec, params.ringDim);
+		}
+		catch (const config_error &)
+		{
+			if (!params.ringDim)
+				throw;
+			cc = generate(params, sec, 0);
+		}
+
+		cc->Enable(ENCRYPTION);
+		cc->Enable(SHE);
+		cc->Enable(LEVELEDSHE);
+	}
+
+	//As with SEAL and HElib, a new key pair drops the old pair's evaluation keys
+	void keyGen()
+	{
+		if (keys.publicKey)
+		{
+			cc->ClearEvalMultKeys(keys.publicKey->GetKeyTag());
+			cc->ClearEvalAutomorphismKeys(keys.publicKey->GetKeyTag());
+		}
+		keys = cc->KeyGen();
+	}
+
+	void relinKeyGen()
+	{
+		needSecret();
+		cc->EvalMultKeyGen(keys.secretKey);
+	}
+
+	//EvalAtIndexKeyGen replaces the key tag's whole automorphism map, so the
+	//keys held before are merged back in, as SEAL merges by Galois element
+	void rotationKeyGen(const std::vector<int> &steps)
+	{
+		needSecret();
+		typedef std::map<usint, LPEvalKey<DCRTPoly>> KeyMap;
+		const std::string &tag = keys.publicKey->GetKeyTag();
+		KeyMap held;
+		if (CryptoContextImpl<DCRTPoly>::GetAllEvalAutomorphismKeys().count(tag))
+			held = cc->GetEvalAutomorphismKeyMap(tag);
+		std::vector<int32_t> indices(steps.begin(), steps.end());
+		cc->EvalAtIndexKeyGen(keys.secretKey, indices);
+		if (held.empty())
+			return;
+		std::shared_ptr<KeyMap> merged(new KeyMap(cc->GetEvalAutomorphismKeyMap(tag)));
+		merged->insert(held.begin(), held.end());
+		CryptoContextImpl<DCRTPoly>::InsertEvalAutomorphismKey(merged);
+	}
+
+	size_t keyBytes() const
+	{
+		std::ostringstream out;
+		cc->SerializeEvalMultKey(out, lbcrypto::SerType::BINARY, cc);
+		cc->SerializeEvalAutomorphismKey(out, lbcrypto::SerType::BINARY, cc);
+		return (size_t)out.tellp();
+	}
+
+	void saveKeys(const std::string &dir) const
+	{
+		savePublicKeys(dir);
+		lbcrypto::Serial::SerializeToFile(dir + "/secret.bin", keys.secretKey, lbcrypto::SerType::BINARY);
+	}
+
+	void savePublicKeys(const std::string &dir) const
+	{
+		using namespace lbcrypto;
+		Serial::SerializeToFile(dir + "/context.bin", cc, SerType::BINARY);
+		Serial::SerializeToFile(dir + "/public.bin", keys.publicKey, SerType::BINARY);
+		std::ofstream mult(dir + "/mult.bin", std::ios::binary);
+		cc->SerializeEvalMultKey(mult, SerType::BINARY);
+		std::ofstream rot(dir + "/rotation.bin", std::ios::binary);
+		cc->SerializeEvalAutomorphismKey(rot, SerType::BINARY);
+	}
+
+	void loadKeys(const std::string &dir, const HEParams &params)
+	{
+		using namespace lbcrypto;
+		this->params = params;
+		//evaluation keys are held per context, so drop whatever an earlier run registered
+		CryptoContextImpl<DCRTPoly>::ClearEvalMultKeys();
+		CryptoContextImpl<DCRTPoly>::ClearEvalAutomorphismKeys();
+		CryptoContextFactory<DCRTPoly>::ReleaseAllContexts();
+
+		if (!Serial::DeserializeFromFile(dir + "/context.bin", cc, SerType::BINARY) ||
+			!Serial::DeserializeFromFile(dir + "/public.bin", keys.publicKey, SerType::BINARY))
+			throw std::runtime_error("cannot read PALISADE keys from " + dir);
+		//absent when written by savePublicKeys
+		keys.secretKey = nullptr;
+		if (std::ifstream(dir + "/secret.bin") &&
+			!Serial::DeserializeFromFile(dir + "/secret.bin", keys.secretKey, SerType::BINARY))
+			throw std::runtime_error("cannot read the PALISADE secret key from " + dir);
+
+		std::ifstream mult(dir + "/mult.bin", std::ios::binary);
+		cc->DeserializeEvalMultKey(mult, SerType::BINARY);
+		std::ifstream rot(dir + "/rotation.bin", std::ios::binary);
+		if (rot)
+			cc->DeserializeEvalAutomorphismKey(rot, SerType::BINARY);
+	}
+
+	size_t slotCount() const
+	{
+		return sch == Scheme::CKKS ? cc->GetRingDimension() / 2 : cc->GetRingDimension();
+	}
+
+	size_t rowSize() const
+	{
+		return sch == Scheme::CKKS ? slotCount() : slotCount() / 2;
+	}
+
+	//PALISADE packs from its own vectors, filled straight from the view
+	PlainPtr encode(ColumnSpan values)
+	{
+		std::shared_ptr<PalisadePlaintext> out(new PalisadePlaintext);
+		size_t n = std::min(values.size, slotCount());
+		HE_TRACE_SCOPE(trace, "encode");
+		HE_TRACE_ARG(trace, "values", n);
+		if (sch == Scheme::CKKS)
+		{
+			std::vector<std::complex<double>> v(values.data, values.data + n);
+			out->p = cc->MakeCKKSPackedPlaintext(v);
+		}
+		else
+		{
+			std::vector<int64_t> v(n);
+			for (size_t i = 0; i < n; i++)
+				v[i] = (int64_t)std::llround(values.data[i]);
+			out->p = cc->MakePackedPlaintext(v);
+		}
+		return out;
+	}
+
+	std::vector<double> decode(const PlainPtr &plain)
+	{
+		const lbcrypto::Plaintext &p = unwrap<PalisadePlaintext>(plain).p;
+		std::vector<double> out;
+		HE_TRACE_SCOPE(trace, "decode");
+		if (sch == Scheme::CKKS)
+		{
+			const std::vector<std::complex<double>> &v = p->GetCKKSPackedValue();
+			out.resize(v.size());
+			for (size_t i = 0; i < v.size(); i++)
+				out[i] = v[i].real();
+		}
+		else
+		{
+			const std::vector<int64_t> &v = p->GetPackedValue();
+			out.assign(v.begin(), v.end());
+		}
+		return out;
+	}
+
+	CipherPtr encrypt(const PlainPtr &plain)
+	{
+		std::shared_ptr<PalisadeCiphertext> out(new PalisadeCiphertext);
+		HE_TRACE_SCOPE(trace, "encrypt");
+		out->c = cc->Encrypt(keys.publicKey, unwrap<PalisadePlaintext>(plain).p);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	//Decrypt also unpacks the slots; decode only converts them
+	PlainPtr decrypt(const CipherPtr &cipher)
+	{
+		needSecret();
+		std::shared_ptr<PalisadePlaintext> out(new PalisadePlaintext);
+		HE_TRACE_SCOPE(trace, "decrypt");
+		HE_TRACE_ONLY(traceCipher(trace, unwrap<PalisadeCiphertext>(cipher).c));
+		cc->Decrypt(keys.secretKey, unwrap<PalisadeCiphertext>(cipher).c, &out->p);
+		return out;
+	}
+
+	CipherPtr add(const CipherPtr &a, const CipherPtr &b)
+	{
+		std::shared_ptr<PalisadeCiphertext> out(new PalisadeCiphertext);
+		HE_TRACE_SCOPE(trace, "add");
+		out->c = cc->EvalAdd(unwrap<PalisadeCiphertext>(a).c, unwrap<PalisadeCiphertext>(b).c);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	CipherPtr multiply(const CipherPtr &a, const CipherPtr &b)
+	{
+		std::shared_ptr<PalisadeCiphertext> out(new PalisadeCiphertext);
+		HE_TRACE_SCOPE(trace, "multiply");
+		out->c = cc->EvalMultNoRelin(unwrap<PalisadeCiphertext>(a).c, unwrap<PalisadeCiphertext>(b).c);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	CipherPtr addPlain(const CipherPtr &a, const PlainPtr &b)
+	{
+		std::shared_ptr<PalisadeCiphertext> out(new PalisadeCiphertext);
+		HE_TRACE_SCOPE(trace, "add-plain");
+		out->c = cc->EvalAdd(unwrap<PalisadeCiphertext>(a).c, unwrap<PalisadePlaintext>(b).p);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	CipherPtr multiplyPlain(const CipherPtr &a, const PlainPtr &b)
+	{
+		std::shared_ptr<PalisadeCiphertext> out(new PalisadeCiphertext);
+		HE_TRACE_SCOPE(trace, "multiply-plain");
+		out->c = cc->EvalMult(unwrap<PalisadeCiphertext>(a).c, unwrap<PalisadePlaintext>(b).p);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	//In-place operations trace the ciphertext they were given
+	void relinearize(CipherPtr &cipher)
+	{
+		PalisadeCiphertext &ct = unwrap<PalisadeCiphertext>(cipher);
+		HE_TRACE_SCOPE(trace, "relinearize");
+		HE_TRACE_ONLY(traceCipher(trace, ct.c));
+		ct.c = cc->Relinearize(ct.c);
+	}
+
+	//CKKS in EXACTRESCALE mode rescales inside the next EvalMult, so only BGV switches here
+	void rescale(CipherPtr &cipher)
+	{
+		if (sch != Scheme::BGV)
+			return;
+		PalisadeCiphertext &ct = unwrap<PalisadeCiphertext>(cipher);
+		HE_TRACE_SCOPE(trace, "rescale");
+		HE_TRACE_ONLY(traceCipher(trace, ct.c));
+		ct.c = cc->ModReduce(ct.c);
+	}
+
+	CipherPtr rotate(const CipherPtr &cipher, int steps)
+	{
+		std::shared_ptr<PalisadeCiphertext> out(new PalisadeCiphertext);
+		HE_TRACE_SCOPE(trace, "rotate");
+		HE_TRACE_ARG(trace, "steps", steps);
+		out->c = cc->EvalAtIndex(unwrap<PalisadeCiphertext>(cipher).c, steps);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	//CKKS and BGVrns hoist: EvalFastRotationPrecompute decomposes the
+	//ciphertext once and EvalFastRotation reuses it for every offset
+	std::vector<CipherPtr> rotateMany(const CipherPtr &cipher, const std::vector<int> &steps)
+	{
+		if (sch == Scheme::BFV)
+			return HEBackend::rotateMany(cipher, steps);
+		const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &c = unwrap<PalisadeCiphertext>(cipher).c;
+		auto digits = cc->EvalFastRotationPrecompute(c);
+		uint32_t m = cc->GetCyclotomicOrder();
+		std::vector<CipherPtr> out;
+		for (size_t i = 0; i < steps.size(); i++)
+		{
+			std::shared_ptr<PalisadeCiphertext> r(new PalisadeCiphertext);
+			r->c = steps[i] ? cc->EvalFastRotation(c, steps[i], m, digits) : c->Clone();
+			out.push_back(r);
+		}
+		return out;
+	}
+
+	size_t ciphertextBytes(const CipherPtr &cipher) const
+	{
+		std::ostringstream out;
+		lbcrypto::Serial::Serialize(unwrap<PalisadeCiphertext>(cipher).c, out, lbcrypto::SerType::BINARY);
+		return (size_t)out.tellp();
+	}
+
+	size_t ciphertextMemory(const CipherPtr &cipher) const
+	{
+		return polyMemory(unwrap<PalisadeCiphertext>(cipher).c->GetElements());
+	}
+
+	//Evaluation keys are registered per key tag in the context's static maps
+	std::vector<std::pair<std::string, size_t>> keyMemory() const
+	{
+		using namespace lbcrypto;
+		std::vector<std::pair<std::string, size_t>> out;
+		out.push_back(std::make_pair("public", polyMemory(keys.publicKey->GetPublicElements())));
+		out.push_back(std::make_pair("secret",
+			keys.secretKey ? polyMemory(std::vector<DCRTPoly>(1, keys.secretKey->GetPrivateElement())) : 0));
+
+		const std::string &tag = keys.publicKey->GetKeyTag();
+		size_t relin = 0, rotation = 0;
+		if (CryptoContextImpl<DCRTPoly>::GetAllEvalMultKeys().count(tag))
+		{
+			const std::vector<LPEvalKey<DCRTPoly>> &mult = cc->GetEvalMultKeyVector(tag);
+			for (size_t i = 0; i < mult.size(); i++)
+				relin += evalKeyMemory(mult[i]);
+		}
+		if (CryptoContextImpl<DCRTPoly>::GetAllEvalAutomorphismKeys().count(tag))
+		{
+			const std::map<usint, LPEvalKey<DCRTPoly>> &rot = cc->GetEvalAutomorphismKeyMap(tag);
+			for (std::map<usint, LPEvalKey<DCRTPoly>>::const_iterator it = rot.begin(); it != rot.end(); ++it)
+				rotation += evalKeyMemory(it->second);
+		}
+		out.push_back(std::make_pair("relin", relin));
+		out.push_back(std::make_pair("rotation", rotation));
+		return out;
+	}
+
+	//PALISADE parallelizes over RNS towers with OpenMP when built with it
+	size_t threads() const
+	{
+#ifdef _OPENMP
+		return (size_t)omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+
+	void setThreads(size_t n)
+	{
+#ifdef _OPENMP
+		omp_set_num_threads((int)std::max<size_t>(n, 1));
+#endif
+	}
+
+	void saveCiphertext(const CipherPtr &cipher, std::ostream &out, const std::string &format) const
+	{
+		checkFormat(*this, format);
+		lbcrypto::Serial::Serialize(unwrap<PalisadeCiphertext>(cipher).c, out, lbcrypto::SerType::BINARY);
+	}
+
+	CipherPtr loadCiphertext(std::istream &in)
+	{
+		std::shared_ptr<PalisadeCiphertext> out(new PalisadeCiphertext);
+		lbcrypto::Serial::Deserialize(out->c, in, lbcrypto::SerType::BINARY);
+		return out;
+	}
+
+protected:
+#ifdef HE_TRACE
+	//Level as towers above the last, the way SEAL counts its chain index
+	static void traceCipher(TraceScope &trace, const lbcrypto::Ciphertext<lbcrypto::DCRTPoly> &c)
+	{
+		HE_TRACE_ARG(trace, "level", c->GetElements()[0].GetNumOfElements() - 1);
+		HE_TRACE_ARG(trace, "size", c->GetElements().size());
+	}
+#endif
+
+	void needSecret() const
+	{
+		if (!keys.secretKey)
+			throw std::logic_error("only public keys are loaded");
+	}
+
+	static size_t polyMemory(const std::vector<lbcrypto::DCRTPoly> &polys)
+	{
+		size_t bytes = 0;
+		for (size_t i = 0; i < polys.size(); i++)
+			bytes += polys[i].GetNumOfElements() * polys[i].GetRingDimension() * sizeof(uint64_t);
+		return bytes;
+	}
+
+	static size_t evalKeyMemory(const lbcrypto::LPEvalKey<lbcrypto::DCRTPoly> &key)
+	{
+		return polyMemory(key->GetAVector()) + polyMemory(key->GetBVector());
+	}
+
+	lbcrypto::CryptoContext<lbcrypto::DCRTPoly> generate(const HEParams &params, lbcrypto::SecurityLevel sec,
+		size_t ringDim) const
+	{
+		using namespace lbcrypto;
+		double sigma = 3.2;
+		if (sch == Scheme::BFV)
+			return CryptoContextFactory<DCRTPoly>::genCryptoContextBFVrns(
+				params.plainModulus, sec, sigma, 0, params.depth, 0, OPTIMIZED, 2, 0, 60, ringDim);
+		if (sch == Scheme::BGV)
+			return CryptoContextFactory<DCRTPoly>::genCryptoContextBGVrns(
+				params.depth, params.plainModulus, sec, sigma, params.depth, OPTIMIZED, BV, ringDim);
+		return CryptoContextFactory<DCRTPoly>::genCryptoContextCKKS(
+			params.depth, params.scaleBits, ringDim / 2, sec, ringDim);
+	}
+
+	Scheme sch;
+	HEParams params;
+	lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc;
+	lbcrypto::LPKeyPair<lbcrypto::DCRTPoly> keys;
+};
+
+#endif
@@ -8,8 +8,12 @@
 #include "palisade.h"
 #include <iostream>
 #include <vector>
-#include <time.h>
 #include <stdlib.h>
+#include "benchmark.h"
+#include "datagen.h"
+#include "omp_threads.h"
+#include "options.h"
+#include "trace.h"
 using namespace std;
 using namespace lbcrypto;
 
@@ -37,120 +41,119 @@ void print(Plaintext v, int length)
     cout << endl;
 }
 
-int main()
+int main(int argc, char **argv)
 {
 	//Check to see if BFVrns is available
 	#ifdef NO_QUADMATH
 	cout << "This program cannot run due to BFVrns not being available for this architecture." 
 	exit(0);
 	#endif
-	srand(time(NULL));
-
-	/*****Set up the CryptoContext*****/
-	clock_t cc_clock;
-	cc_clock = clock();
-	//Parameter Selection based on standard parameters from HE standardization workshop
-  int plaintextModulus = 536903681;
-	double sigma = 3.2;
-	SecurityLevel securityLevel = HEStd_128_classic;
-	uint32_t depth = 2;
+	//Same rows on every run and for every library (datagen.h); --seed picks another set
+	Options opts(argc, argv);
+	unsigned long seed = (unsigned long)opts.getInt("seed", 1);
+	cout << "PALISADE threads: " << applyOpenMPThreads(opts) << endl;
+	int N = 2760;
+	vector<int64_t> first_x(N), second_y(N), third_z(N);
+	fillColumn(first_x.data(), N, 0, seed, ColumnX, true);
+	fillColumn(second_y.data(), N, 0, seed, ColumnY, true);
+	fillColumn(third_z.data(), N, 0, seed, ColumnZ, true);
+
+	Benchmark bench("palisade-bfv", argc, argv);
+	while (bench.next())
+	{
+		/*****Set up the CryptoContext*****/
+		bench.start("context");
+		//Parameter Selection based on standard parameters from HE standardization workshop
+	  int plaintextModulus = 536903681;
+		double sigma = 3.2;
+		SecurityLevel securityLevel = HEStd_128_classic;
+		uint32_t depth = 2;
 
 
-	//Create the cryptoContext with the desired parameters
-	CryptoContext<DCRTPoly> cryptoContext = CryptoContextFactory<DCRTPoly>::genCryptoContextBFVrns(plaintextModulus, securityLevel, sigma, 0, depth, 0, OPTIMIZED);
+		//Create the cryptoContext with the desired parameters
+		CryptoContext<DCRTPoly> cryptoContext = CryptoContextFactory<DCRTPoly>::genCryptoContextBFVrns(plaintextModulus, securityLevel, sigma, 0, depth, 0, OPTIMIZED);
 
-	//Enable wanted functions
-	cryptoContext->Enable(ENCRYPTION);
-	cryptoContext->Enable(SHE);
+		//Enable wanted functions
+		cryptoContext->Enable(ENCRYPTION);
+		cryptoContext->Enable(SHE);
 
-	cc_clock = clock() - cc_clock;
+		bench.stop("context");
 
-	/*****Generate Keys*****/ 
-	clock_t key_clock;
-	key_clock = clock();
+		/*****Generate Keys*****/ 
+		bench.start("keygen");
 
-	//Create the container for the public key   
-	LPKeyPair<DCRTPoly> keyPair;
+		//Create the container for the public key   
+		LPKeyPair<DCRTPoly> keyPair;
 
-	//Generate the keyPair
-	keyPair = cryptoContext->KeyGen();
+		//Generate the keyPair
+		keyPair = cryptoContext->KeyGen();
 
-	//Generate the relinearization key
-	cryptoContext->EvalMultKeyGen(keyPair.secretKey);
+		//Generate the relinearization key
+		cryptoContext->EvalMultKeyGen(keyPair.secretKey);
 
-	key_clock = clock() - key_clock;
+		bench.stop("keygen");
 
-	/*****Encryption*****/
-	clock_t enc_clock;
-	enc_clock = clock();
+		/*****Encoding*****/
+		bench.start("encode");
 
-	//Create and encode the plaintext vectors and variables
-	int N = 2760; 
-	vector<int64_t> first_x; 
-	vector<int64_t> second_y; 
-	vector<int64_t> third_z;   
+		Plaintext plain_first_x = cryptoContext->MakePackedPlaintext(first_x);
+		Plaintext plain_second_y= cryptoContext->MakePackedPlaintext(second_y);
+		Plaintext plain_third_z = cryptoContext->MakePackedPlaintext(third_z);
 
-	for(int i = 0; i < N; i++)
-	{
-		int64_t a = rand() % 25;
-		first_x.push_back(a);
+		bench.stop("encode");
 
-		int64_t b = rand() % 50;
-		second_y.push_back(b);
+		/*****Encryption*****/
+		bench.start("encrypt");
 
-		int64_t c = rand() % 30;
-		third_z.push_back(c);
-	}
+		//Encrypt the encodings
+		auto enc_first_x= cryptoContext->Encrypt(keyPair.publicKey, plain_first_x);
+		auto enc_second_y= cryptoContext->Encrypt(keyPair.publicKey, plain_second_y);
+		auto enc_third_z = cryptoContext->Encrypt(keyPair.publicKey, plain_third_z);
 
-	Plaintext plain_first_x = cryptoContext->MakePackedPlaintext(first_x);
-	Plaintext plain_second_y= cryptoContext->MakePackedPlaintext(second_y);
-	Plaintext plain_third_z = cryptoContext->MakePackedPlaintext(third_z);
+		bench.stop("encrypt");
 
-	//Encrypt the encodings
-	auto enc_first_x= cryptoContext->Encrypt(keyPair.publicKey, plain_first_x);
-	auto enc_second_y= cryptoContext->Encrypt(keyPair.publicKey, plain_second_y);
-	auto enc_third_z = cryptoContext->Encrypt(keyPair.publicKey, plain_third_z);
+		/*****Evaluation*****/
+		bench.start("eval");
 
-	enc_clock = clock() - enc_clock;
+		//One trace span per call (--trace, HE_TRACE builds)
+		Ciphertext<DCRTPoly> enc_x_add_z, enc_final_e;
+		{
+			HE_TRACE_SCOPE(trace, "add");
+			enc_x_add_z = cryptoContext->EvalAdd(enc_first_x, enc_third_z);                  //x+z
+		}
+		{
+			HE_TRACE_SCOPE(trace, "multiply");
+			enc_final_e = cryptoContext->EvalMult(enc_second_y, enc_x_add_z);			//y(x+z)
+		}
 
-	/*****Evaluation*****/
- 	clock_t eval_clock;
-	eval_clock = clock();
+		bench.stop("eval");
 
-	auto enc_x_add_z = cryptoContext->EvalAdd(enc_first_x, enc_third_z);                  //x+z
-	auto enc_final_e = cryptoContext->EvalMult(enc_second_y, enc_x_add_z);			//y(x+z)
+		/*****Decryption*****/
+		bench.start("decrypt");
 
-	eval_clock = clock() - eval_clock;
+		//PALISADE unpacks the slots inside Decrypt, so there is no separate decode phase
+		Plaintext plain_final_e;
+		cryptoContext->Decrypt(keyPair.secretKey, enc_final_e, &plain_final_e);
 
-	/*****Decryption*****/
-	clock_t dec_clock;
-	dec_clock = clock();
+		bench.stop("decrypt");
 
-	Plaintext plain_final_e;
-	cryptoContext->Decrypt(keyPair.secretKey, enc_final_e, &plain_final_e);
+		/*****Print*****/
+		if (!bench.last())
+			continue;
 
-	dec_clock = clock() - dec_clock;
+		cout << "Solving Equation for" << N << " instances. "<< endl << endl;
 
-	/*****Print*****/
-	cout << "Solving Equation for" << N << " instances. "<< endl << endl;
+		cout << "Value_X: " << endl;
+		print(plain_first_x, N);
 
-	cout << "Value_X: " << endl;
-	print(plain_first_x, N);
+		cout << "Value_Y: " << endl;
+		print(plain_second_y, N);
 
-	cout << "Value_Y: " << endl;
-	print(plain_second_y, N);
+		cout << "Value_Z: " << endl;
+		print(plain_third_z, N);
 
-	cout << "Value_Z: " << endl;
-	print(plain_third_z, N);
-
-	cout << " Final Equation: " << endl;
-	print(plain_final_e, N);
-
-	cout << "Times:" <<endl;
-	cout << "Parameter Generation : " << ((float)cc_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Key Generation       : " << ((float)key_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Encryption           : " << ((float)enc_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Evaluation (e = y(x+z))  : " << ((float)eval_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Decryption               : " << ((float)dec_clock)/CLOCKS_PER_SEC << endl;
+		cout << " Final Equation: " << endl;
+		print(plain_final_e, N);
+	}
 	return 0;
 }
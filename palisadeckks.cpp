@@ -7,8 +7,12 @@
 #include "palisade.h"
 #include <iostream>
 #include <vector>
-#include <time.h>
 #include <stdlib.h>
+#include "benchmark.h"
+#include "datagen.h"
+#include "omp_threads.h"
+#include "options.h"
+#include "trace.h"
 using namespace std;
 using namespace lbcrypto;
 
@@ -36,117 +40,114 @@ void print(Plaintext v, int length)
     cout << endl;
 }
 
-int main()
+int main(int argc, char **argv)
 {
-	/*****Setup CryptoContext*****/
-	clock_t cc_clock;
-	cc_clock = clock();
-
-	uint32_t multDepth = 1;
-	uint32_t scaleFactorBits = 50;
-	uint32_t batchSize = 2000; //num plaintext slots
-	SecurityLevel securityLevel = HEStd_128_classic;
+	//Same rows on every run and for every library (datagen.h); --seed picks another set
+	Options opts(argc, argv);
+	unsigned long seed = (unsigned long)opts.getInt("seed", 1);
+	cout << "PALISADE threads: " << applyOpenMPThreads(opts) << endl;
+	int N = 2760;
+	vector<complex<double>> first_x(N), second_y(N), third_z(N);
+	fillColumn(first_x.data(), N, 0, seed, ColumnX, false);
+	fillColumn(second_y.data(), N, 0, seed, ColumnY, false);
+	fillColumn(third_z.data(), N, 0, seed, ColumnZ, false);
+
+	Benchmark bench("palisade-ckks", argc, argv);
+	while (bench.next())
+	{
+		/*****Setup CryptoContext*****/
+		bench.start("context");
 
-	CryptoContext<DCRTPoly> cc =
-			CryptoContextFactory<DCRTPoly>::genCryptoContextCKKS(
-			   multDepth,
-			   scaleFactorBits,
-			   batchSize,
-			   securityLevel);
+		uint32_t multDepth = 1;
+		uint32_t scaleFactorBits = 50;
+		uint32_t batchSize = 2000; //num plaintext slots
+		SecurityLevel securityLevel = HEStd_128_classic;
 
-	//cout << "CKKS scheme is using ring dimension " << cc->GetRingDimension() << endl << endl;
+		CryptoContext<DCRTPoly> cc =
+				CryptoContextFactory<DCRTPoly>::genCryptoContextCKKS(
+				   multDepth,
+				   scaleFactorBits,
+				   batchSize,
+				   securityLevel);
 
-	cc->Enable(ENCRYPTION);
-	cc->Enable(SHE);
+		//cout << "CKKS scheme is using ring dimension " << cc->GetRingDimension() << endl << endl;
 
-	cc_clock = clock() - cc_clock;
+		cc->Enable(ENCRYPTION);
+		cc->Enable(SHE);
 
-	/*****Key Generation*****/
-	clock_t key_clock;
-	key_clock = clock();
+		bench.stop("context");
 
-	auto keys = cc->KeyGen();
-	cc->EvalMultKeyGen(keys.secretKey);
-	cc->EvalAtIndexKeyGen(keys.secretKey, { 1, -2 });
+		/*****Key Generation*****/
+		bench.start("keygen");
 
-	key_clock = clock() - key_clock;
+		auto keys = cc->KeyGen();
+		cc->EvalMultKeyGen(keys.secretKey);
 
-	/*****Encoding*****/
+		bench.stop("keygen");
 
-	clock_t enc_clock;
-	enc_clock = clock();
+		/*****Encoding*****/
+		bench.start("encode");
 
-	int N = 2760; 
-	vector<complex<double>> first_x; 
-	vector<complex<double>> second_y; 
-	vector<complex<double>> third_z;   
+		Plaintext plain_first_x = cc->MakeCKKSPackedPlaintext(first_x);
+		Plaintext plain_second_y = cc->MakeCKKSPackedPlaintext(second_y);
+		Plaintext plain_third_z = cc->MakeCKKSPackedPlaintext(third_z);
 
-	for(int i = 0; i < N; i++)
-	{
-                double a = (rand()/(double(RAND_MAX))*25);
-		first_x.push_back(a);
+		bench.stop("encode");
 
-		double b = (rand()/(double(RAND_MAX))*50);
-		second_y.push_back(b);
+		/*****Encryption*****/
+		bench.start("encrypt");
 
-		double c = (rand()/(double(RAND_MAX))*30);
-		third_z.push_back(c);
+		// Encrypt the encoded vectors
+		auto enc_first_x = cc->Encrypt(keys.publicKey, plain_first_x );
+		auto enc_second_y = cc->Encrypt(keys.publicKey, plain_second_y );
+		auto enc_third_z = cc->Encrypt(keys.publicKey, plain_third_z );
 
-                
-	}
-	
+		bench.stop("encrypt");
 
-	Plaintext plain_first_x = cc->MakeCKKSPackedPlaintext(first_x);
-	Plaintext plain_second_y = cc->MakeCKKSPackedPlaintext(second_y);
-	Plaintext plain_third_z = cc->MakeCKKSPackedPlaintext(third_z);
+		/*****Evaluation*****/
+		bench.start("eval");
 
-	// Encrypt the encoded vectors
-	auto enc_first_x = cc->Encrypt(keys.publicKey, plain_first_x );
-	auto enc_second_y = cc->Encrypt(keys.publicKey, plain_second_y );
-	auto enc_third_z = cc->Encrypt(keys.publicKey, plain_third_z );
+		//One trace span per call (--trace, HE_TRACE builds)
+		Ciphertext<DCRTPoly> cAdd, cMult;
+		{
+			HE_TRACE_SCOPE(trace, "add");
+			cAdd = cc->EvalAdd(enc_first_x , enc_third_z );
+		}
+		{
+			HE_TRACE_SCOPE(trace, "multiply");
+			cMult = cc->EvalMult(cAdd , enc_second_y);
+		}
+		bench.stop("eval");
 
-	enc_clock = clock() - enc_clock;
-
-	/*****Evaluation*****/
-	clock_t eval_clock;
-	eval_clock = clock();
-
-               auto cAdd = cc->EvalAdd(enc_first_x , enc_third_z );
-               auto cMult = cc->EvalMult(cAdd , enc_second_y);
-	eval_clock = clock() - eval_clock;
-
-	/*****Decryption and output*****/
-	clock_t dec_clock;
-	dec_clock = clock();
+		/*****Decryption and output*****/
+		bench.start("decrypt");
 	
-	Plaintext plain_final_e;
-	cout.precision(6);
+		//Decrypt also decodes the CKKS slots, so there is no separate decode phase
+		Plaintext plain_final_e;
+		cout.precision(6);
 
-	cc->Decrypt(keys.secretKey, cMult, &plain_final_e);
+		cc->Decrypt(keys.secretKey, cMult, &plain_final_e);
 
-	dec_clock = clock() - dec_clock;
+		bench.stop("decrypt");
 
-	/*****Print*****/
-	cout << "Solving Equation for" << N << " instances. "<< endl << endl;
+		/*****Print*****/
+		if (!bench.last())
+			continue;
 
-	cout << "Value_X: " << endl;
-	print(plain_first_x, N);
+		cout << "Solving Equation for" << N << " instances. "<< endl << endl;
 
-	cout << "Value_Y: " << endl;
-	print(plain_second_y, N);
+		cout << "Value_X: " << endl;
+		print(plain_first_x, N);
 
-	cout << "Value_Z: " << endl;
-	print(plain_third_z, N);
+		cout << "Value_Y: " << endl;
+		print(plain_second_y, N);
 
-	cout << " Final Equation: " << endl;
-	print(plain_final_e, N);
+		cout << "Value_Z: " << endl;
+		print(plain_third_z, N);
 
-	cout << "Times:" <<endl;
-	cout << "Parameter Generation  : " << ((float)cc_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Key Generation        : " << ((float)key_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Encryption            : " << ((float)enc_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Evaluation (e = y(x+z) ) : " << ((float)eval_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Decryption            : " << ((float)dec_clock)/CLOCKS_PER_SEC << endl;
+		cout << " Final Equation: " << endl;
+		print(plain_final_e, N);
+	}
 
 	return 0;
 }
@@ -0,0 +1,69 @@
+/***************************************/
+/* Parallel y(x+z) over many chunks    */
+/* Every ciphertext is its own task on */
+/* the work-stealing pool: encoding    */
+/* and encryption of each x/y/z chunk, */
+/* evaluation, decryption and decoding */
+/* of each result.                     */
+/***************************************/
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <vector>
+#include "benchmark.h"
+#include "he_backend.h"
+#include "thread_pool.h"
+#include "workload.h"
+
+//Rows [offset, offset + n) of one column, without copying them
+inline ColumnSpan sliceColumn(const std::vector<double> &col, size_t offset, size_t n)
+{
+	return ColumnSpan(col.data() + offset, std::min(col.size(), offset + n) - offset);
+}
+
+//The context and keys must already exist; phases are timed in bench
+inline std::vector<double> runParallelYXZ(HEBackend &he, ThreadPool &pool, const Columns &cols, Benchmark &bench)
+{
+	size_t rows = cols.x.size();
+	size_t slots = he.slotCount();
+	size_t chunks = (rows + slots - 1) / slots;
+	const std::vector<double> *column[3] = { &cols.x, &cols.y, &cols.z };
+
+	//x, y and z of chunk i sit at 3i, 3i+1 and 3i+2
+	std::vector<PlainPtr> plain(3 * chunks);
+	std::vector<CipherPtr> enc(3 * chunks);
+	std::vector<CipherPtr> result(chunks);
+	std::vector<PlainPtr> plain_result(chunks);
+	std::vector<double> out(rows);
+
+	bench.start("encode");
+	pool.parallelFor(3 * chunks, [&](size_t k) {
+		plain[k] = he.encode(sliceColumn(*column[k % 3], (k / 3) * slots, slots));
+	});
+	bench.stop("encode");
+
+	bench.start("encrypt");
+	pool.parallelFor(3 * chunks, [&](size_t k) { enc[k] = he.encrypt(plain[k]); });
+	bench.stop("encrypt");
+
+	bench.start("eval");
+	pool.parallelFor(chunks, [&](size_t i) { result[i] = evalYXZ(he, enc[3 * i], enc[3 * i + 1], enc[3 * i + 2]); });
+	bench.stop("eval");
+
+	bench.start("decrypt");
+	pool.parallelFor(chunks, [&](size_t i) { plain_result[i] = he.decrypt(result[i]); });
+	bench.stop("decrypt");
+
+	bench.start("decode");
+	pool.parallelFor(chunks, [&](size_t i) {
+		std::vector<double> e = he.decode(plain_result[i]);
+		size_t n = std::min(slots, rows - i * slots);
+		std::copy(e.begin(), e.begin() + n, out.begin() + i * slots);
+	});
+	bench.stop("decode");
+
+	return out;
+}
+
+#endif
@@ -0,0 +1,240 @@
+/***************************************/
+/* Parameter planner                   */
+/* Smallest ring dimension, modulus    */
+/* chain and plaintext modulus per     */
+/* backend for a circuit's depth, slot */
+/* demand, value range and security.   */
+/*                                     */
+/* Noise growth is estimated, not      */
+/* proven: hebench --mode plan checks  */
+/* the planned parameters by running   */
+/* the circuit and comparing results.  */
+/***************************************/
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include "he_backend.h"
+
+//What a circuit needs from its parameters
+struct PlanRequest
+{
+	int depth;           //multiplicative depth
+	size_t slots;        //values per ciphertext
+	double maxValue;     //largest |value| anywhere in the circuit
+	int precisionBits;   //CKKS: fractional bits wanted in the result
+	int securityBits;    //128, 192 or 256
+
+	PlanRequest() : depth(1), slots(1), maxValue(1), precisionBits(20), securityBits(128) {}
+};
+
+//Largest log2(q) for ring dimension n at the given classical security
+//(HomomorphicEncryption.org standard, ternary secrets); 0 when n is too small
+inline int maxCoeffBits(size_t n, int securityBits)
+{
+	static const int bits128[] = { 27, 54, 109, 218, 438, 881 };
+	static const int bits192[] = { 19, 37, 75, 152, 305, 611 };
+	static const int bits256[] = { 14, 29, 58, 118, 237, 476 };
+	const int *table = securityBits >= 256 ? bits256 : securityBits >= 192 ? bits192 : bits128;
+	int i = 0;
+	for (size_t d = 1024; d < n && i < 5; d *= 2)
+		i++;
+	return n < 1024 ? 0 : table[i];
+}
+
+inline int bitLength(uint64_t v)
+{
+	int b = 0;
+	for (; v; v >>= 1)
+		b++;
+	return b;
+}
+
+inline uint64_t mulMod(uint64_t a, uint64_t b, uint64_t m)
+{
+	return (uint64_t)((unsigned __int128)a * b % m);
+}
+
+inline uint64_t powMod(uint64_t a, uint64_t e, uint64_t m)
+{
+	uint64_t r = 1;
+	for (a %= m; e; e >>= 1, a = mulMod(a, a, m))
+		if (e & 1)
+			r = mulMod(r, a, m);
+	return r;
+}
+
+//Deterministic Miller-Rabin for 64-bit integers
+inline bool isPrime(uint64_t n)
+{
+	if (n < 2)
+		return false;
+	static const uint64_t bases[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+	for (size_t i = 0; i < 12; i++)
+		if (n % bases[i] == 0)
+			return n == bases[i];
+
+	uint64_t d = n - 1;
+	int s = 0;
+	for (; d % 2 == 0; s++)
+		d /= 2;
+	for (size_t i = 0; i < 12; i++)
+	{
+		uint64_t x = powMod(bases[i], d, n);
+		if (x == 1 || x == n - 1)
+			continue;
+		int r = 1;
+		for (; r < s; r++)
+			if ((x = mulMod(x, x, n)) == n - 1)
+				break;
+		if (r == s)
+			return false;
+	}
+	return true;
+}
+
+//Smallest prime p > above with p = 1 mod step, so p splits into slots
+inline uint64_t batchingPrime(uint64_t above, uint64_t step)
+{
+	for (uint64_t p = (above / step + 1) * step + 1;; p += step)
+		if (isPrime(p))
+			return p;
+}
+
+//Smallest plaintext modulus that holds every value of the circuit in the signed range
+inline uint64_t minPlainModulus(const PlanRequest &req)
+{
+	return 2 * (uint64_t)std::ceil(req.maxValue) + 1;
+}
+
+//BFV/BGV coefficient-modulus bits: fresh noise plus, per level, about
+//log2(t) + log2(n) + 12 bits consumed by multiplication and relinearization
+inline int integerCoeffBits(const PlanRequest &req, uint64_t t, size_t n)
+{
+	int tb = bitLength(t);
+	return tb + 20 + req.depth * (tb + bitLength(n) + 12);
+}
+
+//CKKS scale: roughly 20 bits of the scale are lost to encoding and encryption noise
+inline int ckksScaleBits(const PlanRequest &req)
+{
+	return std::min(60, std::max(20, req.precisionBits + 20));
+}
+
+//CKKS outer primes hold the integer part of the result above the scale
+inline int ckksOuterBits(const PlanRequest &req)
+{
+	int integer = bitLength((uint64_t)std::ceil(req.maxValue)) + 1;
+	int outer = ckksScaleBits(req) + integer;
+	if (outer > 60)
+		throw std::invalid_argument("values up to " + std::to_string(req.maxValue) + " leave no room for "
+			+ std::to_string(req.precisionBits) + " bits of CKKS precision");
+	return outer;
+}
+
+//SEAL: power-of-two n. BFV uses BFVDefault(n), the largest secure chain, with a
+//batching prime; CKKS uses {outer, scale x depth, outer}.
+inline HEParams planSeal(Scheme s, const PlanRequest &req)
+{
+	HEParams p(s);
+	p.securityBits = req.securityBits;
+	p.depth = req.depth;
+	for (size_t n = 1024; n <= 32768; n *= 2)
+	{
+		int budget = maxCoeffBits(n, req.securityBits);
+		if (s == Scheme::CKKS)
+		{
+			if (n / 2 < req.slots)
+				continue;
+			int scale = ckksScaleBits(req), outer = ckksOuterBits(req);
+			if (2 * outer + req.depth * scale > budget)
+				continue;
+			p.ringDim = n;
+			p.scaleBits = scale;
+			p.coeffBits.assign(1, outer);
+			p.coeffBits.insert(p.coeffBits.end(), req.depth, scale);
+			p.coeffBits.push_back(outer);
+			return p;
+		}
+
+		if (n < req.slots)
+			continue;
+		uint64_t t = batchingPrime(minPlainModulus(req) - 1, 2 * n);
+		if (integerCoeffBits(req, t, n) > budget)
+			continue;
+		p.ringDim = n;
+		p.plainModulus = t;
+		p.plainBits = bitLength(t);
+		return p;
+	}
+	throw std::invalid_argument("no SEAL ring dimension up to 32768 fits the circuit");
+}
+
+//PALISADE derives its own modulus chain and ring dimension from t, the depth
+//and the security level; ringDim only raises n to fit the slots. Batching needs
+//t = 1 mod 2n for whatever n PALISADE settles on, so t is taken 1 mod 2^16,
+//which covers every n up to 32768.
+inline HEParams planPalisade(Scheme s, const PlanRequest &req)
+{
+	HEParams p(s);
+	p.securityBits = req.securityBits;
+	p.depth = req.depth;
+	size_t per_slot = s == Scheme::CKKS ? 2 : 1;
+	size_t n = 1024;
+	while (n < per_slot * req.slots)
+		n *= 2;
+	p.ringDim = n;
+	if (s == Scheme::CKKS)
+		p.scaleBits = ckksScaleBits(req);
+	else
+		p.plainModulus = batchingPrime(minPlainModulus(req) - 1, 65536);
+	return p;
+}
+
+//HElib: prime m with p = 1 mod m gives m - 1 slots. phi(m) = m - 1 must reach
+//the standard ring dimension for the chain, whose bits follow integerCoeffBits
+//with an extra level of headroom for HElib's modulus switching.
+inline HEParams planHelib(const PlanRequest &req)
+{
+	HEParams p(Scheme::BGV);
+	p.securityBits = req.securityBits;
+	p.depth = req.depth;
+	p.c = 2;
+	p.r = 1;
+	for (size_t n = 1024; n <= 32768; n *= 2)
+	{
+		long m = (long)std::max(n, req.slots) + 1;
+		while (!isPrime((uint64_t)m))
+			m++;
+		uint64_t t = batchingPrime(std::max<uint64_t>(minPlainModulus(req) - 1, (uint64_t)m), (uint64_t)m);
+		PlanRequest deeper = req;
+		deeper.depth++;
+		int bits = integerCoeffBits(deeper, t, (size_t)m);
+		if (bits > maxCoeffBits(n, req.securityBits))
+			continue;
+		p.m = m;
+		p.plainModulus = t;
+		p.bits = bits;
+		return p;
+	}
+	throw std::invalid_argument("no HElib cyclotomic up to 32768 fits the circuit");
+}
+
+//Planned parameters for he's library and scheme
+inline HEParams planParams(const HEBackend &he, const PlanRequest &req)
+{
+	std::string name = he.name();
+	if (name.compare(0, 5, "seal-") == 0)
+		return planSeal(he.scheme(), req);
+	if (name.compare(0, 9, "palisade-") == 0)
+		return planPalisade(he.scheme(), req);
+	if (name.compare(0, 6, "helib-") == 0)
+		return planHelib(req);
+	throw std::invalid_argument("no parameter plan for backend " + name);
+}
+
+#endif
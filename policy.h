@@ -0,0 +1,221 @@
+/***************************************/
+/* Relinearization and modulus-        */
+/* switching policy                    */
+/* PolicyBackend wraps another backend */
+/* and decides when products are       */
+/* relinearized (eagerly, lazily or    */
+/* never for outputs) and how far      */
+/* results are switched down before    */
+/* decryption or serialization.        */
+/***************************************/
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "he_backend.h"
+
+struct EvalPolicy
+{
+	//eager: relinearize every product when the circuit asks;
+	//lazy: defer until the value is multiplied, rotated or output;
+	//never: as lazy, but outputs are left unrelinearized
+	enum Relin { Eager, Lazy, Never };
+
+	Relin relin;
+	bool modSwitch;    //switch outputs to the lowest level that keeps safetyBits
+	int safetyBits;    //noise budget that must remain after switching
+	bool measured;     //judge levels by the secret-key budget, a client-side check
+
+	EvalPolicy(Relin r = Eager, bool ms = false, int safety = 10, bool measured = false)
+		: relin(r), modSwitch(ms), safetyBits(safety), measured(measured)
+	{
+	}
+
+	std::string describe() const
+	{
+		std::string s = relin == Eager ? "eager" : relin == Lazy ? "lazy" : "never";
+		return modSwitch ? s + (measured ? "+modswitch-measured" : "+modswitch") : s;
+	}
+};
+
+//Inner ciphertext, whether it still holds an unrelinearized product, and
+//the products behind it, for estimating its noise
+struct PolicyCiphertext : HECiphertext
+{
+	PolicyCiphertext(const CipherPtr &c, bool pending, int depth) : c(c), pending(pending), depth(depth) {}
+	CipherPtr c;
+	bool pending;
+	int depth;
+};
+
+//Forwards to another backend under an EvalPolicy. Ciphertexts are wrapped, so
+//every operation on them must go through this backend. Not for concurrent use.
+class PolicyBackend : public HEBackend
+{
+public:
+	PolicyBackend(HEBackend &inner, const EvalPolicy &policy)
+		: he(inner), policy(policy), relinearizations(0), switches(0)
+	{
+	}
+
+	const EvalPolicy &evalPolicy() const { return policy; }
+	size_t relinCount() const { return relinearizations; }
+	size_t switchCount() const { return switches; }
+
+	std::string name() const { return he.name(); }
+	Scheme scheme() const { return he.scheme(); }
+	HEParams defaultParams() const { return he.defaultParams(); }
+	void createContext(const HEParams &params) { he.createContext(params); }
+	void keyGen() { he.keyGen(); }
+	void relinKeyGen() { he.relinKeyGen(); }
+	void rotationKeyGen(const std::vector<int> &steps) { he.rotationKeyGen(steps); }
+	size_t keyBytes() const { return he.keyBytes(); }
+	void saveKeys(const std::string &dir) const { he.saveKeys(dir); }
+	void savePublicKeys(const std::string &dir) const { he.savePublicKeys(dir); }
+	void loadKeys(const std::string &dir, const HEParams &params) { he.loadKeys(dir, params); }
+	size_t slotCount() const { return he.slotCount(); }
+	size_t rowSize() const { return he.rowSize(); }
+
+	PlainPtr encode(ColumnSpan values) { return he.encode(values); }
+	std::vector<double> decode(const PlainPtr &plain) { return he.decode(plain); }
+	CipherPtr encrypt(const PlainPtr &plain) { return wrap(he.encrypt(plain), false, 0); }
+
+	PlainPtr decrypt(const CipherPtr &cipher)
+	{
+		CipherPtr out = cipher;
+		finish(out);
+		return he.decrypt(inner(out));
+	}
+
+	//Sums of unrelinearized products stay unrelinearized, so lazy
+	//relinearization pays once per sum rather than once per product
+	CipherPtr add(const CipherPtr &a, const CipherPtr &b)
+	{
+		const PolicyCiphertext &x = unwrap<PolicyCiphertext>(a), &y = unwrap<PolicyCiphertext>(b);
+		return wrap(he.add(x.c, y.c), x.pending || y.pending, std::max(x.depth, y.depth));
+	}
+
+	CipherPtr multiply(const CipherPtr &a, const CipherPtr &b)
+	{
+		int depth = std::max(unwrap<PolicyCiphertext>(a).depth, unwrap<PolicyCiphertext>(b).depth) + 1;
+		return wrap(he.multiply(ready(a), ready(b)), true, depth);
+	}
+
+	//A plaintext operand adds no key-switching part, so pending carries through
+	CipherPtr addPlain(const CipherPtr &a, const PlainPtr &b)
+	{
+		const PolicyCiphertext &x = unwrap<PolicyCiphertext>(a);
+		return wrap(he.addPlain(x.c, b), x.pending, x.depth);
+	}
+
+	CipherPtr multiplyPlain(const CipherPtr &a, const PlainPtr &b)
+	{
+		const PolicyCiphertext &x = unwrap<PolicyCiphertext>(a);
+		return wrap(he.multiplyPlain(x.c, b), x.pending, x.depth + 1);
+	}
+
+	void relinearize(CipherPtr &cipher)
+	{
+		if (policy.relin == EvalPolicy::Eager)
+			ready(cipher);
+	}
+
+	void rescale(CipherPtr &cipher) { he.rescale(unwrap<PolicyCiphertext>(cipher).c); }
+	CipherPtr rotate(const CipherPtr &cipher, int steps)
+	{
+		return wrap(he.rotate(ready(cipher), steps), false, unwrap<PolicyCiphertext>(cipher).depth);
+	}
+	std::vector<CipherPtr> rotateMany(const CipherPtr &cipher, const std::vector<int> &steps)
+	{
+		std::vector<CipherPtr> out = he.rotateMany(ready(cipher), steps);
+		for (size_t i = 0; i < out.size(); i++)
+			out[i] = wrap(out[i], false, unwrap<PolicyCiphertext>(cipher).depth);
+		return out;
+	}
+
+	size_t ciphertextBytes(const CipherPtr &cipher) const { return he.ciphertextBytes(inner(cipher)); }
+	size_t ciphertextMemory(const CipherPtr &cipher) const { return he.ciphertextMemory(inner(cipher)); }
+	std::vector<std::pair<std::string, size_t>> keyMemory() const { return he.keyMemory(); }
+	size_t poolBytes() const { return he.poolBytes(); }
+	void setObjectPooling(bool on) { he.setObjectPooling(on); }
+	PoolStats objectPool() const { return he.objectPool(); }
+	size_t threads() const { return he.threads(); }
+	void setThreads(size_t n) { he.setThreads(n); }
+	int noiseBudget(const CipherPtr &cipher) const { return he.noiseBudget(inner(cipher)); }
+	int estimateBudget(const CipherPtr &cipher, int) const { return budget(cipher, false); }
+
+	std::vector<std::string> wireFormats() const { return he.wireFormats(); }
+	//Writes the ciphertext as it stands; call finish first for a result
+	void saveCiphertext(const CipherPtr &cipher, std::ostream &out, const std::string &format) const
+	{
+		he.saveCiphertext(inner(cipher), out, format);
+	}
+	//Loaded ciphertexts are taken to be fresh uploads
+	CipherPtr loadCiphertext(std::istream &in) { return wrap(he.loadCiphertext(in), false, 0); }
+	void encryptTo(const PlainPtr &plain, std::ostream &out, const std::string &format) { he.encryptTo(plain, out, format); }
+
+	CipherPtr modSwitch(const CipherPtr &cipher)
+	{
+		const PolicyCiphertext &w = unwrap<PolicyCiphertext>(cipher);
+		CipherPtr c = he.modSwitch(w.c);
+		return c ? wrap(c, w.pending, w.depth) : c;
+	}
+
+	//Output policy, applied before decryption and before serializing a result:
+	//pending relinearization (unless never), then modulus switching down to the
+	//lowest level whose estimated noise budget stays at or above safetyBits.
+	//The estimate needs no secret key, so a server holding only public keys
+	//can switch too. Where the backend reports no budget, outputs are not switched.
+	void finish(CipherPtr &cipher)
+	{
+		if (policy.relin != EvalPolicy::Never)
+			ready(cipher);
+		if (!policy.modSwitch || budget(cipher, policy.measured) < 0)
+			return;
+
+		for (;;)
+		{
+			CipherPtr lower = modSwitch(cipher);
+			if (!lower || budget(lower, policy.measured) < policy.safetyBits)
+				break;
+			cipher = lower;
+			switches++;
+		}
+	}
+
+private:
+	static CipherPtr wrap(const CipherPtr &c, bool pending, int depth)
+	{
+		return CipherPtr(new PolicyCiphertext(c, pending, depth));
+	}
+	static const CipherPtr &inner(const CipherPtr &cipher) { return unwrap<PolicyCiphertext>(cipher).c; }
+
+	int budget(const CipherPtr &cipher, bool measured) const
+	{
+		const PolicyCiphertext &w = unwrap<PolicyCiphertext>(cipher);
+		return measured ? he.noiseBudget(w.c) : he.estimateBudget(w.c, w.depth);
+	}
+
+	//The inner ciphertext, relinearized first if it holds a product. Relinearizing
+	//keeps the value, so it happens in place and every holder of it benefits.
+	const CipherPtr &ready(const CipherPtr &cipher)
+	{
+		PolicyCiphertext &w = unwrap<PolicyCiphertext>(cipher);
+		if (w.pending)
+		{
+			he.relinearize(w.c);
+			w.pending = false;
+			relinearizations++;
+		}
+		return w.c;
+	}
+
+	HEBackend &he;
+	EvalPolicy policy;
+	size_t relinearizations;
+	size_t switches;
+};
+
+#endif
@@ -0,0 +1,286 @@
+/***************************************/
+/* Polynomial evaluation               */
+/* p(x) = c0 + c1 x + ... + cd x^d on  */
+/* one ciphertext, Paterson-Stockmeyer */
+/* style: baby powers x..x^(k-1) and   */
+/* giant powers x^k, x^2k, x^4k ... by */
+/* a balanced power tree, blocks of k  */
+/* coefficients combined as            */
+/* low + x^half * high. Depth is about */
+/* log2(d) + 1, where the extra level  */
+/* is the scalar products; k = d + 1   */
+/* is plain power-tree evaluation.     */
+/***************************************/
+#ifndef POLY_H
+#define POLY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "he_backend.h"
+#include "keys.h"
+#include "planner.h"
+
+//Baby-step block size; a block of degree + 1 or more is one block of powers
+struct PolyPlan
+{
+	size_t baby;
+
+	explicit PolyPlan(size_t baby = 1) : baby(baby) {}
+
+	bool powerTree(size_t degree) const { return baby > degree; }
+	std::string describe(size_t degree) const
+	{
+		return powerTree(degree) ? "power-tree" : "ps k=" + std::to_string(baby);
+	}
+};
+
+class PolyEvaluator
+{
+public:
+	PolyEvaluator(HEBackend &he, const std::vector<double> &coeffs, const PolyPlan &plan)
+		: he(he), coeffs(coeffs), plan(plan)
+	{
+		if (coeffs.empty() || plan.baby == 0)
+			throw std::invalid_argument("a polynomial needs coefficients and a baby step of at least 1");
+	}
+
+	CipherPtr run(const CipherPtr &x)
+	{
+		pw.assign(2, CipherPtr());
+		pw[1] = x;
+		//blocks of baby coefficients, doubled until they cover every coefficient
+		size_t span = plan.baby;
+		while (span < coeffs.size())
+			span *= 2;
+		Term t = block(0, span);
+		pw.clear();
+		if (!t.c)
+			return he.encrypt(constant(t.constant));
+		return t.constant != 0 ? he.addPlain(t.c, constant(t.constant)) : t.c;
+	}
+
+private:
+	//c + constant; c null is the constant alone
+	struct Term
+	{
+		CipherPtr c;
+		double constant;
+	};
+
+	double coeff(size_t i) const { return i < coeffs.size() ? coeffs[i] : 0; }
+
+	PlainPtr constant(double v) { return he.encode(std::vector<double>(he.slotCount(), v)); }
+
+	CipherPtr product(const CipherPtr &a, const CipherPtr &b)
+	{
+		CipherPtr p = he.multiply(a, b);
+		he.relinearize(p);
+		he.rescale(p);
+		return p;
+	}
+
+	CipherPtr scaled(const CipherPtr &c, double k)
+	{
+		if (k == 1)
+			return c;
+		CipherPtr p = he.multiplyPlain(c, constant(k));
+		he.rescale(p);
+		return p;
+	}
+
+	//x^i as x^hi * x^(i-hi), hi the largest power of two below i: depth
+	//ceil(log2 i), and powers of two are squarings shared by every block
+	CipherPtr power(size_t i)
+	{
+		if (pw.size() <= i)
+			pw.resize(i + 1);
+		if (!pw[i])
+		{
+			size_t hi = 1;
+			while (2 * hi < i)
+				hi *= 2;
+			pw[i] = product(power(hi), power(i - hi));
+		}
+		return pw[i];
+	}
+
+	//Coefficients first .. first+count-1 as a polynomial in x
+	Term block(size_t first, size_t count)
+	{
+		Term t = { CipherPtr(), coeff(first) };
+		if (count <= plan.baby)
+		{
+			for (size_t i = 1; i < count; i++)
+				if (coeff(first + i) != 0)
+				{
+					CipherPtr s = scaled(power(i), coeff(first + i));
+					t.c = t.c ? he.add(t.c, s) : s;
+				}
+			return t;
+		}
+
+		size_t half = count / 2;
+		Term low = block(first, half), high = block(first + half, half);
+		if (!high.c && high.constant == 0)
+			return low;
+		//fold high's constant in first: one product instead of two
+		CipherPtr top;
+		if (!high.c)
+			top = scaled(power(half), high.constant);
+		else
+			top = product(high.constant != 0 ? he.addPlain(high.c, constant(high.constant)) : high.c, power(half));
+		low.c = low.c ? he.add(low.c, top) : top;
+		return low;
+	}
+
+	HEBackend &he;
+	const std::vector<double> &coeffs;
+	PolyPlan plan;
+	std::vector<CipherPtr> pw;
+};
+
+inline CipherPtr evalPoly(HEBackend &he, const CipherPtr &x, const std::vector<double> &coeffs, const PolyPlan &plan)
+{
+	return PolyEvaluator(he, coeffs, plan).run(x);
+}
+
+//Multiplicative depth and operation counts of an evaluation
+struct PolyCost
+{
+	int depth;
+	size_t multiplications;   //ciphertext by ciphertext, each relinearized
+	size_t scalars;           //by a plaintext constant; a level in CKKS and BGV
+
+	PolyCost() : depth(0), multiplications(0), scalars(0) {}
+
+	bool operator<(const PolyCost &o) const
+	{
+		if (depth != o.depth)
+			return depth < o.depth;
+		if (multiplications != o.multiplications)
+			return multiplications < o.multiplications;
+		return scalars < o.scalars;
+	}
+};
+
+//KeyProbe that tracks the depth of every ciphertext and counts products.
+//Scalar products count as a level, as CKKS and BGV spend one on them.
+class DepthProbe : public KeyProbe
+{
+public:
+	DepthProbe(Scheme s, size_t slots, size_t rowSize) : KeyProbe(s, slots, rowSize) {}
+
+	const PolyCost &cost() const { return total; }
+	int depthOf(const CipherPtr &c) const { return unwrap<DepthCipher>(c).depth; }
+
+	CipherPtr encrypt(const PlainPtr &) { return make(0); }
+	CipherPtr add(const CipherPtr &a, const CipherPtr &b) { return make(std::max(depthOf(a), depthOf(b))); }
+	CipherPtr addPlain(const CipherPtr &a, const PlainPtr &) { return make(depthOf(a)); }
+
+	CipherPtr multiply(const CipherPtr &a, const CipherPtr &b)
+	{
+		total.multiplications++;
+		return make(std::max(depthOf(a), depthOf(b)) + 1);
+	}
+
+	CipherPtr multiplyPlain(const CipherPtr &a, const PlainPtr &)
+	{
+		total.scalars++;
+		return make(depthOf(a) + 1);
+	}
+
+private:
+	struct DepthCipher : HECiphertext
+	{
+		int depth;
+	};
+
+	CipherPtr make(int depth)
+	{
+		std::shared_ptr<DepthCipher> c(new DepthCipher);
+		c->depth = depth;
+		total.depth = std::max(total.depth, depth);
+		return c;
+	}
+
+	PolyCost total;
+};
+
+inline PolyCost polyCost(Scheme s, const std::vector<double> &coeffs, const PolyPlan &plan)
+{
+	DepthProbe probe(s, 1, 1);
+	CipherPtr out = evalPoly(probe, probe.encrypt(PlainPtr()), coeffs, plan);
+	PolyCost cost = probe.cost();
+	cost.depth = probe.depthOf(out);
+	return cost;
+}
+
+//The baby step with the smallest depth, then fewest products: every power
+//of two up to the degree, and power-tree evaluation (baby = degree + 1)
+inline PolyPlan planPoly(Scheme s, const std::vector<double> &coeffs)
+{
+	size_t degree = coeffs.size() - 1;
+	PolyPlan best(degree + 1);
+	PolyCost best_cost = polyCost(s, coeffs, best);
+	for (size_t k = 1; k <= degree; k *= 2)
+	{
+		PolyCost c = polyCost(s, coeffs, PolyPlan(k));
+		if (c < best_cost)
+		{
+			best = PolyPlan(k);
+			best_cost = c;
+		}
+	}
+	return best;
+}
+
+//Horner per slot; the inner loop runs across slots, so it vectorizes
+inline std::vector<double> referencePoly(const std::vector<double> &x, const std::vector<double> &coeffs)
+{
+	std::vector<double> out(x.size(), coeffs.back());
+	for (size_t i = coeffs.size() - 1; i-- > 0;)
+		for (size_t k = 0; k < x.size(); k++)
+			out[k] = out[k] * x[k] + coeffs[i];
+	return out;
+}
+
+//p(x) mod t for integer inputs and coefficients
+inline std::vector<uint64_t> referencePolyMod(const std::vector<double> &x, const std::vector<double> &coeffs,
+	uint64_t t)
+{
+	auto reduce = [t](double v) {
+		int64_t i = (int64_t)std::llround(v);
+		uint64_t r = (uint64_t)(i < 0 ? -i : i) % t;
+		return i < 0 && r ? t - r : r;
+	};
+	std::vector<uint64_t> out(x.size(), reduce(coeffs.back()));
+	for (size_t i = coeffs.size() - 1; i-- > 0;)
+	{
+		uint64_t c = reduce(coeffs[i]);
+		for (size_t k = 0; k < x.size(); k++)
+			out[k] = (mulMod(out[k], reduce(x[k]), t) + c) % t;
+	}
+	return out;
+}
+
+//Largest distance between a decoded integer result and the reference, mod t
+inline double maxErrorMod(const std::vector<double> &got, const std::vector<uint64_t> &want, uint64_t t)
+{
+	double err = 0;
+	for (size_t i = 0; i < want.size(); i++)
+	{
+		int64_t g = i < got.size() ? (int64_t)std::llround(got[i]) : 0;
+		uint64_t r = (uint64_t)(g < 0 ? -g : g) % t;
+		uint64_t gm = g < 0 && r ? t - r : r;
+		uint64_t d = gm >= want[i] ? gm - want[i] : want[i] - gm;
+		err = std::max(err, (double)std::min(d, t - d));
+	}
+	return err;
+}
+
+#endif
@@ -0,0 +1,289 @@
+/***************************************/
+/* Object pool                         */
+/* Ciphertext and plaintext objects    */
+/* kept per modulus level. Dropping    */
+/* the last reference puts an object   */
+/* back on its level's free list, and  */
+/* the next acquire at that level pops */
+/* it, so a library writes each result */
+/* into storage it has already sized.  */
+/* shared_ptr control blocks are       */
+/* recycled too: a warm pool allocates */
+/* nothing.                            */
+/***************************************/
+#ifndef POOL_H
+#define POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+//Objects handed out, and how many of those had to be created
+struct PoolStats
+{
+	uint64_t acquired;
+	uint64_t created;
+	size_t held;   //objects the pool owns, in use or free
+
+	PoolStats() : acquired(0), created(0), held(0) {}
+};
+
+template <class T>
+class ObjectPool
+{
+public:
+	//make builds a fresh object; each level keeps at most limit free ones
+	explicit ObjectPool(std::function<T *()> make, size_t limit = 256) : state(new State(std::move(make), limit)) {}
+
+	//A free object last used at this level, or a new one. With pooling off
+	//the object is an ordinary shared_ptr, freed with its last reference.
+	std::shared_ptr<T> acquire(size_t level)
+	{
+		T *obj = 0;
+		void *block = 0;
+		uint64_t generation;
+		bool pooled;
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->counts.acquired++;
+			pooled = state->enabled;
+			if (!pooled)
+				state->counts.created++;
+			else if (level < state->free.size() && !state->free[level].empty())
+			{
+				obj = state->free[level].back();
+				state->free[level].pop_back();
+			}
+			else
+			{
+				state->counts.created++;
+				state->held++;
+			}
+			if (pooled && !state->blocks.empty())
+			{
+				block = state->blocks.back();
+				state->blocks.pop_back();
+			}
+			generation = state->generation;
+		}
+		if (!pooled)
+			return std::shared_ptr<T>(state->make());
+		if (!obj)
+		{
+			try
+			{
+				obj = state->make();
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->held--;
+				if (block)
+					state->blocks.push_back(block);
+				throw;
+			}
+		}
+		return std::shared_ptr<T>(obj, Recycle(state, level, generation), Blocks<T>(state, block));
+	}
+
+	//An object found to hold another level than it was acquired at, such as
+	//a loaded ciphertext, goes back on that level's list when released
+	void setLevel(const std::shared_ptr<T> &obj, size_t level)
+	{
+		Recycle *r = std::get_deleter<Recycle>(obj);
+		if (r)
+			r->level = level;
+	}
+
+	//Off drops every free object; those in use are freed as their users release them
+	void setEnabled(bool on)
+	{
+		std::vector<std::vector<T *>> dropped;
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->enabled = on;
+			if (!on)
+				dropped = state->takeFree();
+		}
+		State::destroy(dropped);
+	}
+
+	bool isEnabled() const
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		return state->enabled;
+	}
+
+	//Objects sized for an old context must not be reused with a new one; those
+	//still in use are freed rather than returned
+	void clear()
+	{
+		std::vector<std::vector<T *>> dropped;
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			dropped = state->takeFree();
+		}
+		State::destroy(dropped);
+	}
+
+	PoolStats stats() const
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		PoolStats s = state->counts;
+		s.held = state->held;
+		return s;
+	}
+
+private:
+	//Shared with every object handed out, so a release after the pool is
+	//gone still has somewhere to go
+	struct State
+	{
+		State(std::function<T *()> make, size_t limit)
+			: make(std::move(make)), limit(limit), enabled(true), generation(0), block_bytes(0), held(0)
+		{
+		}
+
+		~State()
+		{
+			destroy(free);
+			for (size_t i = 0; i < blocks.size(); i++)
+				::operator delete(blocks[i]);
+		}
+
+		//Called with the mutex held; a new generation turns away objects in use
+		std::vector<std::vector<T *>> takeFree()
+		{
+			std::vector<std::vector<T *>> out;
+			out.swap(free);
+			for (size_t l = 0; l < out.size(); l++)
+				held -= out[l].size();
+			generation++;
+			return out;
+		}
+
+		static void destroy(const std::vector<std::vector<T *>> &lists)
+		{
+			for (size_t l = 0; l < lists.size(); l++)
+				for (size_t i = 0; i < lists[l].size(); i++)
+					delete lists[l][i];
+		}
+
+		std::function<T *()> make;
+		size_t limit;
+		bool enabled;
+		uint64_t generation;
+		std::mutex mutex;
+		std::vector<std::vector<T *>> free;   //per level
+		std::vector<void *> blocks;           //spare control blocks
+		size_t block_bytes;
+		PoolStats counts;
+		size_t held;
+	};
+
+	//Deleter: back on the free list unless the pool was cleared since, or the
+	//level already keeps limit free objects
+	struct Recycle
+	{
+		Recycle(const std::shared_ptr<State> &state, size_t level, uint64_t generation)
+			: state(state), level(level), generation(generation)
+		{
+		}
+
+		void operator()(T *obj) const
+		{
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				if (state->enabled && generation == state->generation)
+				{
+					if (state->free.size() <= level)
+						state->free.resize(level + 1);
+					if (state->free[level].size() < state->limit)
+					{
+						state->free[level].push_back(obj);
+						return;
+					}
+				}
+				state->held--;
+			}
+			delete obj;
+		}
+
+		std::shared_ptr<State> state;
+		size_t level;
+		uint64_t generation;
+	};
+
+	//Control-block allocator: the block popped by acquire, or a new one; freed
+	//blocks go back to the pool, as every block of one pool has the same size
+	template <class U>
+	struct Blocks
+	{
+		typedef U value_type;
+		template <class V>
+		struct rebind
+		{
+			typedef Blocks<V> other;
+		};
+
+		Blocks(const std::shared_ptr<State> &state, void *ready) : state(state), ready(ready) {}
+		template <class V>
+		Blocks(const Blocks<V> &o) : state(o.state), ready(o.ready)
+		{
+		}
+
+		U *allocate(size_t n)
+		{
+			size_t bytes = n * sizeof(U);
+			if (ready)
+			{
+				void *p = ready;
+				ready = 0;
+				if (bytes <= state->block_bytes)
+					return static_cast<U *>(p);
+				giveBack(p);
+			}
+			return static_cast<U *>(::operator new(bytes));
+		}
+
+		void deallocate(U *p, size_t n)
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			if (!state->block_bytes)
+				state->block_bytes = n * sizeof(U);
+			//one spare block per object the pool still owns
+			if (n * sizeof(U) == state->block_bytes && state->blocks.size() < state->held)
+				state->blocks.push_back(p);
+			else
+				::operator delete(p);
+		}
+
+		void giveBack(void *p)
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->blocks.push_back(p);
+		}
+
+		bool operator==(const Blocks &o) const { return state == o.state; }
+		bool operator!=(const Blocks &o) const { return state != o.state; }
+
+		std::shared_ptr<State> state;
+		void *ready;
+	};
+
+	std::shared_ptr<State> state;
+};
+
+inline PoolStats operator+(PoolStats a, const PoolStats &b)
+{
+	a.acquired += b.acquired;
+	a.created += b.created;
+	a.held += b.held;
+	return a;
+}
+
+#endif
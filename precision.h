@@ -0,0 +1,145 @@
+/***************************************/
+/* CKKS precision explorer             */
+/* Error of a decrypted CKKS result in */
+/* bits, candidate parameter sets over */
+/* scale, modulus chain and ring       */
+/* dimension, and the frontier of the  */
+/* sets no other set beats on both     */
+/* latency and error.                  */
+/***************************************/
+#ifndef PRECISION_H
+#define PRECISION_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "he_backend.h"
+#include "planner.h"
+
+//Absolute error over every slot compared
+struct ErrorStats
+{
+	double max, mean, rms;
+};
+
+//Four independent lanes per accumulator, so the loop vectorizes without
+//reassociating floating-point sums
+inline ErrorStats errorStats(const std::vector<double> &got, const std::vector<double> &want)
+{
+	if (got.size() < want.size())
+		throw std::invalid_argument("result has fewer slots than the reference");
+	const size_t lanes = 4;
+	double sum[lanes] = { 0 }, sq[lanes] = { 0 }, most[lanes] = { 0 };
+	size_t n = want.size(), i = 0;
+	for (; i + lanes <= n; i += lanes)
+		for (size_t j = 0; j < lanes; j++)
+		{
+			double d = std::fabs(got[i + j] - want[i + j]);
+			sum[j] += d;
+			sq[j] += d * d;
+			most[j] = std::max(most[j], d);
+		}
+	for (; i < n; i++)
+	{
+		double d = std::fabs(got[i] - want[i]);
+		sum[0] += d;
+		sq[0] += d * d;
+		most[0] = std::max(most[0], d);
+	}
+	ErrorStats e = { 0, 0, 0 };
+	for (size_t j = 0; j < lanes; j++)
+	{
+		e.max = std::max(e.max, most[j]);
+		e.mean += sum[j];
+		e.rms += sq[j];
+	}
+	if (n)
+	{
+		e.mean /= n;
+		e.rms = std::sqrt(e.rms / n);
+	}
+	return e;
+}
+
+//log2 of an error: -20 means about 20 correct fractional bits
+inline double errorBits(double err)
+{
+	return err > 0 ? std::log2(err) : -std::numeric_limits<double>::infinity();
+}
+
+//CKKS parameter sets for a circuit: every ring dimension with room for the
+//slots, every scale, and the circuit's depth plus each count of extra levels.
+//SEAL chains are {outer, scale x levels, outer} with outer primes wide enough
+//for the integer part of the result, within the security budget of the ring;
+//PALISADE takes the ring as a lower bound and sizes the chain itself.
+inline std::vector<HEParams> ckksCandidates(const HEBackend &he, const PlanRequest &req,
+	const std::vector<size_t> &rings, const std::vector<int> &scales, const std::vector<int> &extraLevels)
+{
+	if (he.scheme() != Scheme::CKKS)
+		throw std::invalid_argument(he.name() + " is not a CKKS backend");
+	bool seal = he.name().compare(0, 5, "seal-") == 0;
+	int integer = bitLength((uint64_t)std::ceil(req.maxValue)) + 1;
+	std::vector<HEParams> out;
+	for (size_t r = 0; r < rings.size(); r++)
+		for (size_t s = 0; s < scales.size(); s++)
+			for (size_t e = 0; e < extraLevels.size(); e++)
+			{
+				size_t n = rings[r];
+				int scale = scales[s], levels = req.depth + extraLevels[e];
+				if (n / 2 < req.slots)
+					continue;
+				HEParams p(Scheme::CKKS);
+				p.securityBits = req.securityBits;
+				p.ringDim = n;
+				p.scaleBits = scale;
+				p.depth = levels;
+				if (seal)
+				{
+					int outer = scale + integer;
+					if (outer > 60 || 2 * outer + levels * scale > maxCoeffBits(n, req.securityBits))
+						continue;
+					p.coeffBits.assign(1, outer);
+					p.coeffBits.insert(p.coeffBits.end(), levels, scale);
+					p.coeffBits.push_back(outer);
+				}
+				out.push_back(p);
+			}
+	return out;
+}
+
+//One measured parameter set
+struct PrecisionPoint
+{
+	HEParams params;
+	size_t ring;      //the ring dimension the library settled on
+	double seconds;   //encode to decode
+	ErrorStats error;
+	bool frontier;
+
+	PrecisionPoint() : ring(0), seconds(0), error(), frontier(false) {}
+};
+
+//A point is on the frontier when every faster point has a larger max error
+inline void markFrontier(std::vector<PrecisionPoint> &points)
+{
+	std::vector<size_t> order(points.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return points[a].seconds != points[b].seconds ? points[a].seconds < points[b].seconds
+			: points[a].error.max < points[b].error.max;
+	});
+	double best = std::numeric_limits<double>::infinity();
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		PrecisionPoint &p = points[order[i]];
+		p.frontier = p.error.max < best;
+		if (p.frontier)
+			best = p.error.max;
+	}
+}
+
+#endif
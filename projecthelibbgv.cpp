@@ -6,9 +6,13 @@
 /***************************************/
 #include <iostream>
 #include <vector>
-#include <time.h>
 #include <stdlib.h>
 #include <helib/helib.h>
+#include <NTL/BasicThreadPool.h>
+#include "benchmark.h"
+#include "datagen.h"
+#include "options.h"
+#include "trace.h"
 
 using namespace std;
 using namespace helib;
@@ -37,134 +41,155 @@ void print(vector<long> v, long length)
     cout << endl;
 }
 
-int main()
+int main(int argc, char **argv)
 {
-	srand(time(NULL));
-	/*****Set Parameters*****/
-	clock_t cc_clock;
-	cc_clock = clock();
-
-	unsigned long p   = 55001;
-	unsigned long m  = 32109;
-	unsigned long bits = 300;
-	unsigned long c = 2;
-        unsigned long r = 1;
-
-	//Generate context and add primes to chain
-	 helib::Context context = helib::ContextBuilder<helib::BGV>()
-                               .m(m)
-                               .p(p)
-                               .r(r)
-                               .bits(bits)
-                               .c(c)
-                               .build();
-	//Context context(cyc_poly, prime_mod, 1);
-	//buildModChain(context, bits_mod_chain, key_switch_col);
-	// Print the context
-  	context.printout();
- 	 std::cout << std::endl;
-
-  	// Print the security level
-  	std::cout << "Security: " << context.securityLevel() << std::endl;
-
-	cc_clock = clock() - cc_clock;
-
-	//Key Generation
-	clock_t key_clock;
-	key_clock = clock();
-
-	// Secret key management
-  	std::cout << "Creating secret key..." << std::endl;
-  	// Create a secret key associated with the context
-  	helib::SecKey secret_key(context);
- 	 // Generate the secret key
-	  secret_key.GenSecKey();
- 	 std::cout << "Generating key-switching matrices..." << std::endl;
- 	 // Compute key-switching matrices that we need
-	  helib::addSome1DMatrices(secret_key);
-
- 	 // Public key management
-  	// Set the secret key (upcast: SecKey is a subclass of PubKey)
- 	 const helib::PubKey& public_key = secret_key;
-
-	 // Get the EncryptedArray of the context
-  	const helib::EncryptedArray& ea = context.getEA();
-
- 	 // Get the number of slot (phi(m))
-	  long nslots = ea.size();
-	  std::cout << "Number of slots: " << nslots << std::endl;
-
-	key_clock = clock() - key_clock;
-
-	//Encryption
-	clock_t enc_clock;
-	enc_clock = clock();
-
-	vector<long> first_x;
-	vector<long> second_y;
-	vector<long> third_z;
-
-	for(int i = 0; i < nslots; i++)
+	//Same rows on every run and for every library (datagen.h); --seed picks another set
+	Options opts(argc, argv);
+	unsigned long seed = (unsigned long)opts.getInt("seed", 1);
+	//--threads N sizes NTL's thread pool, which HElib splits CRT primes across
+	if (opts.has("threads"))
+		NTL::SetNumThreads(opts.getInt("threads", 1));
+	cout << "NTL threads: " << NTL::AvailableThreads() << endl;
+	Benchmark bench("helib-bgv", argc, argv);
+	while (bench.next())
 	{
-		int64_t a = rand() % 25;
-		first_x.push_back(a);
+		/*****Set Parameters*****/
+		bench.start("context");
+
+		unsigned long p   = 55001;
+		unsigned long m  = 32109;
+		unsigned long bits = 300;
+		unsigned long c = 2;
+	        unsigned long r = 1;
+
+		//Generate context and add primes to chain
+		 helib::Context context = helib::ContextBuilder<helib::BGV>()
+	                               .m(m)
+	                               .p(p)
+	                               .r(r)
+	                               .bits(bits)
+	                               .c(c)
+	                               .build();
+		//Context context(cyc_poly, prime_mod, 1);
+		//buildModChain(context, bits_mod_chain, key_switch_col);
+
+		bench.stop("context");
+
+		if (bench.last())
+		{
+			// Print the context
+			context.printout();
+			std::cout << std::endl;
+
+			// Print the security level
+			std::cout << "Security: " << context.securityLevel() << std::endl;
+		}
+
+		//Key Generation
+		bench.start("keygen");
 
-		int64_t b = rand() % 50;
-		second_y.push_back(b);
+	  	// Create a secret key associated with the context
+	  	helib::SecKey secret_key(context);
+	 	 // Generate the secret key
+		  secret_key.GenSecKey();
+
+	 	 // Public key management
+	  	// Set the secret key (upcast: SecKey is a subclass of PubKey)
+	 	 const helib::PubKey& public_key = secret_key;
+
+		 // Get the EncryptedArray of the context
+	  	const helib::EncryptedArray& ea = context.getEA();
+
+	 	 // Get the number of slot (phi(m))
+		  long nslots = ea.size();
+
+		bench.stop("keygen");
+
+		vector<long> first_x(nslots), second_y(nslots), third_z(nslots);
+		fillColumn(first_x.data(), nslots, 0, seed, ColumnX, true);
+		fillColumn(second_y.data(), nslots, 0, seed, ColumnY, true);
+		fillColumn(third_z.data(), nslots, 0, seed, ColumnZ, true);
+
+		//Encode
+		bench.start("encode");
+
+		NTL::ZZX plain_first_x, plain_second_y, plain_third_z;
+		ea.encode(plain_first_x, first_x);
+		ea.encode(plain_second_y, second_y);
+		ea.encode(plain_third_z, third_z);
+
+		bench.stop("encode");
+
+		//Encryption
+		bench.start("encrypt");
+
+		Ctxt enc_first_x(public_key);
+		Ctxt enc_second_y(public_key);
+		Ctxt enc_third_z(public_key);
+		Ctxt enc_final_e(public_key);
+		public_key.Encrypt(enc_first_x, plain_first_x);
+		public_key.Encrypt(enc_second_y, plain_second_y);
+		public_key.Encrypt(enc_third_z, plain_third_z);
+
+		bench.stop("encrypt");
+
+		//Evaluation
+		bench.start("eval");
+
+		//One trace span per call (--trace, HE_TRACE builds), with the result's size
+		{
+			HE_TRACE_SCOPE(trace, "add");
+			enc_final_e += enc_first_x;
+			enc_final_e += enc_third_z;
+		}
+		//Multiply and relinearize explicitly instead of leaving it to operator *=
+		{
+			HE_TRACE_SCOPE(trace, "multiply");
+			enc_final_e.multLowLvl(enc_second_y);
+			HE_TRACE_ARG(trace, "size", enc_final_e.size());
+		}
+		{
+			HE_TRACE_SCOPE(trace, "relinearize");
+			enc_final_e.reLinearize();
+		}
+
+		bench.stop("eval");
 
-		int64_t c = rand() % 30;
-		third_z.push_back(c);
-	}
-
-	Ctxt enc_first_x(public_key);
-	Ctxt enc_second_y(public_key);
-	Ctxt enc_third_z(public_key);
-	Ctxt enc_final_e(public_key);
-	ea.encrypt(enc_first_x, public_key, first_x);
-	ea.encrypt(enc_second_y, public_key, second_y);
-	ea.encrypt(enc_third_z, public_key, third_z);
-
-	enc_clock = clock() - enc_clock;
+		//Decrypt
+		bench.start("decrypt");
+
+		NTL::ZZX plain_final_e;
+		secret_key.Decrypt(plain_final_e, enc_final_e);
 
-	//Evaluation
-	clock_t eval_clock;
-	eval_clock = clock();
+		bench.stop("decrypt");
 
-	enc_final_e += enc_first_x;
-	enc_final_e += enc_third_z;
-	enc_final_e *= enc_second_y;
+		//Decode
+		bench.start("decode");
 
-	eval_clock = clock() - eval_clock;
+		vector<long> final_e;
+		ea.decode(final_e, plain_final_e);
 
-	//Decrypt
-	clock_t dec_clock;
-	dec_clock = clock();
+		bench.stop("decode");
 
-	vector<long> final_e;
-	ea.decrypt(enc_final_e, secret_key, final_e);
+		/*****Print*****/
+		if (!bench.last())
+			continue;
 
-	dec_clock = clock() - dec_clock;
-	/*****Print*****/
-	cout << "Solving the equation for " << nslots << " instances. "<< endl << endl;
+		std::cout << "Number of slots: " << nslots << std::endl;
+		cout << "Solving the equation for " << nslots << " instances. "<< endl << endl;
 
-	cout << "Value_X: " << endl;
-	print(first_x, nslots);
+		cout << "Value_X: " << endl;
+		print(first_x, nslots);
 
-	cout << "Value_Y: " << endl;
-	print(second_y, nslots);
+		cout << "Value_Y: " << endl;
+		print(second_y, nslots);
 
-	cout << "Value_Z: " << endl;
-	print(third_z, nslots);
+		cout << "Value_Z: " << endl;
+		print(third_z, nslots);
 
-	cout << "Final Equation: " << endl;
-	print(final_e, nslots);
-
-	cout << "Times:" <<endl;
-	cout << "Parameter Generation  : " << ((float)cc_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Key Generation        : " << ((float)key_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Encryption            : " << ((float)enc_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Evaluation (e = y(x+z)   ) : " << ((float)eval_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Decryption            : " << ((float)dec_clock)/CLOCKS_PER_SEC << endl;
+		cout << "Final Equation: " << endl;
+		print(final_e, nslots);
+	}
 	return 0;
 
 }
@@ -6,140 +6,145 @@
 /****************************************/
 
 #include <iostream>
-#include <time.h>
 #include <stdlib.h>
 #include <vector>
 #include "seal/seal.h"
 #include "examples.h"
+#include "benchmark.h"
+#include "datagen.h"
+#include "options.h"
+#include "trace.h"
 
 using namespace std;
 using namespace seal;
 
-int main()
+int main(int argc, char **argv)
 {
-	/*****Set Parameters and Context*****/
-	clock_t cc_clock;
-	cc_clock = clock();
-
-	EncryptionParameters parms(scheme_type::CKKS);
-
-	 size_t poly_modulus_degree = 8192;
-    parms.set_poly_modulus_degree(poly_modulus_degree);
-    parms.set_coeff_modulus(CoeffModulus::Create(
-        poly_modulus_degree, { 60, 40, 40, 60 }));
+	//Same rows on every run and for every library (datagen.h); --seed picks another set
+	Options opts(argc, argv);
+	unsigned long seed = (unsigned long)opts.getInt("seed", 1);
+	int N = 2760;
+	vector<double> first_x(N), second_y(N), third_z(N);
+	fillColumn(first_x.data(), N, 0, seed, ColumnX, false);
+	fillColumn(second_y.data(), N, 0, seed, ColumnY, false);
+	fillColumn(third_z.data(), N, 0, seed, ColumnZ, false);
+
+	Benchmark bench("seal-ckks", argc, argv);
+	//SEAL takes ciphertexts and temporaries from its global memory pool
+	bench.poolProbe([] { return (size_t)MemoryManager::GetPool().alloc_byte_count(); });
+	//Declared once: each run writes into the storage the previous run sized
+	Plaintext plain_first_x, plain_second_y, plain_third_z, plain_final_e;
+	Ciphertext enc_first_x, enc_second_y, enc_third_z, enc_final_e, enc_sum;
+	vector<double> final_e;
+	while (bench.next())
+	{
+		/*****Set Parameters and Context*****/
+		bench.start("context");
 
-	double scale = pow(2.0, 40);
+		EncryptionParameters parms(scheme_type::CKKS);
 
-    auto context = SEALContext::Create(parms);
+		 size_t poly_modulus_degree = 8192;
+	    parms.set_poly_modulus_degree(poly_modulus_degree);
+	    parms.set_coeff_modulus(CoeffModulus::Create(
+	        poly_modulus_degree, { 60, 40, 40, 60 }));
 
-	/*****Key Generation*****/
-	clock_t key_clock;
-	key_clock = clock();
+		double scale = pow(2.0, 40);
 
-    KeyGenerator keygen(context);
-    auto public_key = keygen.public_key();
-    auto secret_key = keygen.secret_key();
-    auto relin_keys = keygen.relin_keys();
-    Encryptor encryptor(context, public_key);
-    Evaluator evaluator(context);
-    Decryptor decryptor(context, secret_key);
+	    auto context = SEALContext::Create(parms);
 
-    CKKSEncoder encoder(context);
-    size_t slot_count = encoder.slot_count();
-    cout << "Number of slots: " << slot_count << endl;
-	cc_clock = clock() - cc_clock - key_clock;
+	    CKKSEncoder encoder(context);
+	    size_t slot_count = encoder.slot_count();
 
-	/*****Encode and Encrypt*****/
-	clock_t enc_clock;
-	enc_clock = clock();
+		bench.stop("context");
 
-    int N = 2760; 
-	vector<double> first_x; 
-	vector<double> second_y; 
-	vector<double> third_z;   
+		/*****Key Generation*****/
+		bench.start("keygen");
 
-	for(int i = 0; i < N; i++)
-	{
-		double a = (rand()/(double(RAND_MAX))*50);
-		first_x.push_back(a);
+	    KeyGenerator keygen(context);
+	    auto public_key = keygen.public_key();
+	    auto secret_key = keygen.secret_key();
+	    auto relin_keys = keygen.relin_keys();
 
-		double b = (rand()/(double(RAND_MAX))*50);
-		second_y.push_back(b);
+		bench.stop("keygen");
 
-		double c = (rand()/(double(RAND_MAX))*50);
-		third_z.push_back(c);
-	}
+	    Encryptor encryptor(context, public_key);
+	    Evaluator evaluator(context);
+	    Decryptor decryptor(context, secret_key);
 
+		/*****Encode*****/
+		bench.start("encode");
 
+	    encoder.encode(first_x, scale, plain_first_x);
+	    encoder.encode(second_y, scale, plain_second_y);
+	    encoder.encode(third_z, scale, plain_third_z);
 
-    Plaintext plain_first_x, plain_second_y, plain_third_z;
-    encoder.encode(first_x, scale, plain_first_x);
-    encoder.encode(second_y, scale, plain_second_y);
-    encoder.encode(third_z, scale, plain_third_z);
+		bench.stop("encode");
 
-    Ciphertext enc_first_x, enc_second_y, enc_third_z;
-    	encryptor.encrypt(plain_first_x, enc_first_x);
-	encryptor.encrypt(plain_second_y, enc_second_y);
-	encryptor.encrypt(plain_third_z, enc_third_z);
+		/*****Encrypt*****/
+		bench.start("encrypt");
 
-	enc_clock = clock() - enc_clock;
+	    	encryptor.encrypt(plain_first_x, enc_first_x);
+		encryptor.encrypt(plain_second_y, enc_second_y);
+		encryptor.encrypt(plain_third_z, enc_third_z);
 
-    /*****Evaluate*****/
-	clock_t eval_clock;
-	eval_clock = clock();
+		bench.stop("encrypt");
 
-    Ciphertext enc_final_e, enc_mul;
+	    /*****Evaluate*****/
+		bench.start("eval");
 
-                evaluator.multiply(enc_first_x, enc_second_y, enc_final_e);
-	evaluator.relinearize_inplace(enc_final_e, relin_keys);
-	evaluator.rescale_to_next_inplace(enc_final_e);
+		//One trace span per call (--trace, HE_TRACE builds), with the result's size and level
+		{
+			HE_TRACE_SCOPE(trace, "add");
+			evaluator.add(enc_first_x, enc_third_z, enc_sum);
+		}
+		{
+			HE_TRACE_SCOPE(trace, "multiply");
+			evaluator.multiply(enc_second_y, enc_sum, enc_final_e);
+			HE_TRACE_ARG(trace, "size", enc_final_e.size());
+		}
+		{
+			HE_TRACE_SCOPE(trace, "relinearize");
+			evaluator.relinearize_inplace(enc_final_e, relin_keys);
+		}
+		{
+			HE_TRACE_SCOPE(trace, "rescale");
+			evaluator.rescale_to_next_inplace(enc_final_e);
+			HE_TRACE_ARG(trace, "level", context->get_context_data(enc_final_e.parms_id())->chain_index());
+		}
 
-                evaluator.multiply(enc_third_z, enc_second_y, enc_mul);
-	evaluator.relinearize_inplace(enc_mul, relin_keys);
-	evaluator.rescale_to_next_inplace(enc_mul);
+		bench.stop("eval");
 
-	
-	enc_final_e.scale() = pow(2.0,40);
-	enc_mul.scale() = pow(2.0,40);
+		/*****Decrypt*****/
+		bench.start("decrypt");
 
-	parms_id_type last_parms_id = enc_final_e.parms_id();
-	evaluator.mod_switch_to_inplace(enc_mul, last_parms_id);
-	evaluator.add_inplace(enc_final_e, enc_mul);
-	
-	eval_clock = clock() - eval_clock;
+		decryptor.decrypt(enc_final_e, plain_final_e);
 
-	/*****Decrypt*****/
-	clock_t dec_clock;
-	dec_clock = clock();
+		bench.stop("decrypt");
 
-	Plaintext plain_final_e;
-	decryptor.decrypt(enc_final_e, plain_final_e);
+		/*****Decode*****/
+		bench.start("decode");
 
-	dec_clock = clock() - dec_clock;
+		encoder.decode(plain_final_e, final_e);
 
-	/*****Decode*****/
-	vector<double> final_e;
-	encoder.decode(plain_final_e, final_e);
+		bench.stop("decode");
 
-	/*****Print*****/
-	cout << "Solving Equation for " << N << " instances. "<< endl << endl;
-	cout << "Value_X: " << endl;
-	print_vector(first_x, 10, 4);
+		/*****Print*****/
+		if (!bench.last())
+			continue;
 
-	cout << "Value_Y: " << endl;
-	print_vector(second_y, 10, 4);
+	    cout << "Number of slots: " << slot_count << endl;
+		cout << "Solving Equation for " << N << " instances. "<< endl << endl;
+		cout << "Value_X: " << endl;
+		print_vector(first_x, 10, 4);
 
-	cout << "Value_z: " << endl;
-	print_vector(third_z, 10, 4);
+		cout << "Value_Y: " << endl;
+		print_vector(second_y, 10, 4);
 
-	cout << " Final Equation: " << endl;
-	print_vector(final_e, 15, 4);
+		cout << "Value_z: " << endl;
+		print_vector(third_z, 10, 4);
 
-	cout << "Times:" <<endl;
-	cout << "Parameter Generation  : " << ((float)cc_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Key Generation        : " << ((float)key_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Encryption            : " << ((float)enc_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Evaluation (e=y(x+z)) : " << ((float)eval_clock)/CLOCKS_PER_SEC << endl;
-	cout << "Decryption            : " << ((float)dec_clock)/CLOCKS_PER_SEC << endl;
+		cout << " Final Equation: " << endl;
+		print_vector(final_e, 15, 4);
+	}
 
 }
@@ -0,0 +1,636 @@
+/***************************************/
+/* SEAL adapter for HEBackend          */
+/* BFV with BatchEncoder, CKKS with    */
+/* CKKSEncoder (SEAL 3.4). Results go  */
+/* into pooled objects (pool.h).       */
+/***************************************/
+#ifndef SEAL_BACKEND_H
+#define SEAL_BACKEND_H
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include "seal/seal.h"
+#include "he_backend.h"
+#include "trace.h"
+
+struct SealPlaintext : HEPlaintext
+{
+	seal::Plaintext p;
+};
+
+struct SealCiphertext : HECiphertext
+{
+	seal::Ciphertext c;
+};
+
+class SealBackend : public HEBackend
+{
+public:
+	explicit SealBackend(Scheme s)
+		: sch(s), ciphers([] { return new SealCiphertext; }), plains([] { return new SealPlaintext; })
+	{
+		if (s == Scheme::BGV)
+			throw std::invalid_argument("SEAL 3.4 has no BGV scheme");
+	}
+
+	std::string name() const { return sch == Scheme::CKKS ? "seal-ckks" : "seal-bfv"; }
+	Scheme scheme() const { return sch; }
+
+	HEParams defaultParams() const
+	{
+		HEParams p(sch);
+		p.ringDim = 8192;
+		if (sch == Scheme::CKKS)
+		{
+			p.coeffBits = { 60, 40, 40, 60 };
+			p.scaleBits = 40;
+			p.depth = 2;
+		}
+		else
+		{
+			p.plainBits = 20;
+		}
+		return p;
+	}
+
+	void createContext(const HEParams &params)
+	{
+		this->params = params;
+		seal::EncryptionParameters parms(sch == Scheme::CKKS ? seal::scheme_type::CKKS : seal::scheme_type::BFV);
+		parms.set_poly_modulus_degree(params.ringDim);
+		if (params.coeffBits.empty())
+			parms.set_coeff_modulus(seal::CoeffModulus::BFVDefault(params.ringDim, securityLevel()));
+		else
+			parms.set_coeff_modulus(seal::CoeffModulus::Create(params.ringDim, params.coeffBits));
+
+		if (sch == Scheme::BFV)
+		{
+			if (params.plainModulus)
+				parms.set_plain_modulus(params.plainModulus);
+			else
+				parms.set_plain_modulus(seal::PlainModulus::Batching(params.ringDim, params.plainBits));
+		}
+		initContext(parms);
+	}
+
+	void keyGen()
+	{
+		keygen.reset(new seal::KeyGenerator(context));
+		public_key = keygen->public_key();
+		secret_key = keygen->secret_key();
+		relin_keys = seal::RelinKeys();
+		galois_keys = seal::GaloisKeys();
+		initKeys();
+	}
+
+	void relinKeyGen()
+	{
+		needSecret();
+		relin_keys = keygen->relin_keys();
+	}
+
+	//GaloisKeys are indexed by Galois element, so new keys merge slot by slot
+	void rotationKeyGen(const std::vector<int> &steps)
+	{
+		needSecret();
+		seal::GaloisKeys fresh = keygen->galois_keys(steps);
+		if (!galois_keys.size())
+		{
+			galois_keys = fresh;
+			return;
+		}
+		if (galois_keys.data().size() < fresh.data().size())
+			galois_keys.data().resize(fresh.data().size());
+		for (size_t i = 0; i < fresh.data().size(); i++)
+			if (!fresh.data()[i].empty())
+				galois_keys.data()[i] = fresh.data()[i];
+	}
+
+	size_t keyBytes() const
+	{
+		std::ostringstream out;
+		if (relin_keys.size())
+			relin_keys.save(out, seal::compr_mode_type::none);
+		if (galois_keys.size())
+			galois_keys.save(out, seal::compr_mode_type::none);
+		return (size_t)out.tellp();
+	}
+
+	void saveKeys(const std::string &dir) const
+	{
+		savePublicKeys(dir);
+		std::ofstream sk(dir + "/secret.bin", std::ios::binary);
+		secret_key.save(sk);
+	}
+
+	void savePublicKeys(const std::string &dir) const
+	{
+		std::ofstream parms_file(dir + "/parms.bin", std::ios::binary);
+		context->key_context_data()->parms().save(parms_file);
+		std::ofstream pk(dir + "/public.bin", std::ios::binary);
+		public_key.save(pk);
+		if (relin_keys.size())
+		{
+			std::ofstream rk(dir + "/relin.bin", std::ios::binary);
+			relin_keys.save(rk);
+		}
+		if (galois_keys.size())
+		{
+			std::ofstream gk(dir + "/galois.bin", std::ios::binary);
+			galois_keys.save(gk);
+		}
+	}
+
+	void loadKeys(const std::string &dir, const HEParams &params)
+	{
+		this->params = params;
+		seal::EncryptionParameters parms;
+		std::ifstream parms_file(dir + "/parms.bin", std::ios::binary);
+		parms.load(parms_file);
+		initContext(parms);
+
+		std::ifstream pk(dir + "/public.bin", std::ios::binary);
+		public_key.load(context, pk);
+		std::ifstream sk(dir + "/secret.bin", std::ios::binary);
+		if (sk)
+			secret_key.load(context, sk);
+		else
+			secret_key = seal::SecretKey();
+		std::ifstream rk(dir + "/relin.bin", std::ios::binary);
+		if (rk)
+			relin_keys.load(context, rk);
+		else
+			relin_keys = seal::RelinKeys();
+		std::ifstream gk(dir + "/galois.bin", std::ios::binary);
+		if (gk)
+			galois_keys.load(context, gk);
+		else
+			galois_keys = seal::GaloisKeys();
+
+		//rebuilt from the stored secret key so further Galois keys can be made
+		if (sk)
+			keygen.reset(new seal::KeyGenerator(context, secret_key));
+		else
+			keygen.reset();
+		initKeys();
+	}
+
+	size_t slotCount() const
+	{
+		return sch == Scheme::CKKS ? ckks_encoder->slot_count() : batch_encoder->slot_count();
+	}
+
+	size_t rowSize() const
+	{
+		return sch == Scheme::CKKS ? slotCount() : slotCount() / 2;
+	}
+
+	//BFV values are written reduced mod t into the plaintext's coefficients in
+	//matrix order, then batched in place; SEAL maps them to the 2 x N/2 slots
+	PlainPtr encode(ColumnSpan values)
+	{
+		std::shared_ptr<SealPlaintext> out = plains.acquire(sch == Scheme::CKKS ? topLevel() : 0);
+		size_t n = std::min(values.size, slotCount());
+		HE_TRACE_SCOPE(trace, "encode");
+		HE_TRACE_ARG(trace, "values", n);
+		if (sch == Scheme::CKKS)
+		{
+#ifdef SEAL_USE_MSGSL
+			ckks_encoder->encode(gsl::span<const double>(values.data, n), scale, out->p);
+#else
+			ckks_encoder->encode(std::vector<double>(values.data, values.data + n), scale, out->p);
+#endif
+			return out;
+		}
+
+		uint64_t t = context->first_context_data()->parms().plain_modulus().value();
+		out->p.resize(slotCount());
+		for (size_t i = 0; i < n; i++)
+		{
+			int64_t v = (int64_t)std::llround(values.data[i]);
+			uint64_t r = (uint64_t)(v < 0 ? -v : v) % t;
+			out->p[i] = v < 0 && r ? t - r : r;
+		}
+		//a recycled plaintext still holds its last values past n
+		if (n < slotCount())
+			out->p.set_zero(n);
+		batch_encoder->encode(out->p);
+		return out;
+	}
+
+	std::vector<double> decode(const PlainPtr &plain)
+	{
+		const seal::Plaintext &p = unwrap<SealPlaintext>(plain).p;
+		std::vector<double> out;
+		HE_TRACE_SCOPE(trace, "decode");
+		if (sch == Scheme::CKKS)
+		{
+			ckks_encoder->decode(p, out);
+		}
+		else
+		{
+			std::vector<int64_t> ints;
+			batch_encoder->decode(p, ints);
+			out.assign(ints.begin(), ints.end());
+		}
+		return out;
+	}
+
+	CipherPtr encrypt(const PlainPtr &plain)
+	{
+		std::shared_ptr<SealCiphertext> out = ciphers.acquire(topLevel());
+		HE_TRACE_SCOPE(trace, "encrypt");
+		encryptor->encrypt(unwrap<SealPlaintext>(plain).p, out->c);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	PlainPtr decrypt(const CipherPtr &cipher)
+	{
+		needSecret();
+		const seal::Ciphertext &c = unwrap<SealCiphertext>(cipher).c;
+		std::shared_ptr<SealPlaintext> out = plains.acquire(sch == Scheme::CKKS ? level(c) : 0);
+		HE_TRACE_SCOPE(trace, "decrypt");
+		HE_TRACE_ONLY(traceCipher(trace, c));
+		decryptor->decrypt(c, out->p);
+		return out;
+	}
+
+	CipherPtr add(const CipherPtr &a, const CipherPtr &b)
+	{
+		HE_TRACE_SCOPE(trace, "add");
+		const seal::Ciphertext *x = &unwrap<SealCiphertext>(a).c, *y = &unwrap<SealCiphertext>(b).c;
+		std::shared_ptr<SealCiphertext> xs, ys;
+		align(x, y, xs, ys);
+		//rescaled CKKS operands carry scales that differ only by the prime ratio;
+		//anything further apart is a real mismatch
+		if (sch == Scheme::CKKS && y->scale() != x->scale())
+		{
+			checkScale(y->scale(), x->scale());
+			if (!ys)
+			{
+				ys = ciphers.acquire(level(*y));
+				ys->c = *y;
+				y = &ys->c;
+			}
+			ys->c.scale() = x->scale();
+		}
+
+		std::shared_ptr<SealCiphertext> out = ciphers.acquire(level(*x));
+		evaluator->add(*x, *y, out->c);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	CipherPtr multiply(const CipherPtr &a, const CipherPtr &b)
+	{
+		HE_TRACE_SCOPE(trace, "multiply");
+		const seal::Ciphertext *x = &unwrap<SealCiphertext>(a).c, *y = &unwrap<SealCiphertext>(b).c;
+		std::shared_ptr<SealCiphertext> xs, ys;
+		align(x, y, xs, ys);
+
+		std::shared_ptr<SealCiphertext> out = ciphers.acquire(level(*x));
+		evaluator->multiply(*x, *y, out->c);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	CipherPtr addPlain(const CipherPtr &a, const PlainPtr &b)
+	{
+		HE_TRACE_SCOPE(trace, "add-plain");
+		const seal::Ciphertext &x = unwrap<SealCiphertext>(a).c;
+		const seal::Plaintext *y = &unwrap<SealPlaintext>(b).p;
+		std::shared_ptr<SealPlaintext> ys;
+		if (sch == Scheme::CKKS)
+		{
+			y = plainAt(y, x, ys);
+			//an operand encoded at the scale, added to a product that was not
+			//rescaled, would be off by a factor of the scale
+			if (y->scale() != x.scale())
+			{
+				checkScale(y->scale(), x.scale());
+				if (!ys)
+				{
+					ys = plains.acquire(level(x));
+					ys->p = *y;
+					y = &ys->p;
+				}
+				ys->p.scale() = x.scale();
+			}
+		}
+
+		std::shared_ptr<SealCiphertext> out = ciphers.acquire(level(x));
+		evaluator->add_plain(x, *y, out->c);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	CipherPtr multiplyPlain(const CipherPtr &a, const PlainPtr &b)
+	{
+		HE_TRACE_SCOPE(trace, "multiply-plain");
+		const seal::Ciphertext &x = unwrap<SealCiphertext>(a).c;
+		const seal::Plaintext *y = &unwrap<SealPlaintext>(b).p;
+		std::shared_ptr<SealPlaintext> ys;
+		if (sch == Scheme::CKKS)
+			y = plainAt(y, x, ys);
+
+		std::shared_ptr<SealCiphertext> out = ciphers.acquire(level(x));
+		evaluator->multiply_plain(x, *y, out->c);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	//In-place operations trace the ciphertext they were given
+	void relinearize(CipherPtr &cipher)
+	{
+		HE_TRACE_SCOPE(trace, "relinearize");
+		HE_TRACE_ONLY(traceCipher(trace, unwrap<SealCiphertext>(cipher).c));
+		evaluator->relinearize_inplace(unwrap<SealCiphertext>(cipher).c, relin_keys);
+	}
+
+	void rescale(CipherPtr &cipher)
+	{
+		if (sch != Scheme::CKKS)
+			return;
+		HE_TRACE_SCOPE(trace, "rescale");
+		HE_TRACE_ONLY(traceCipher(trace, unwrap<SealCiphertext>(cipher).c));
+		evaluator->rescale_to_next_inplace(unwrap<SealCiphertext>(cipher).c);
+	}
+
+	CipherPtr rotate(const CipherPtr &cipher, int steps)
+	{
+		std::shared_ptr<SealCiphertext> out = ciphers.acquire(level(unwrap<SealCiphertext>(cipher).c));
+		HE_TRACE_SCOPE(trace, "rotate");
+		HE_TRACE_ARG(trace, "steps", steps);
+		if (sch == Scheme::CKKS)
+			evaluator->rotate_vector(unwrap<SealCiphertext>(cipher).c, steps, galois_keys, out->c);
+		else
+			evaluator->rotate_rows(unwrap<SealCiphertext>(cipher).c, steps, galois_keys, out->c);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	size_t ciphertextBytes(const CipherPtr &cipher) const
+	{
+		std::ostringstream out;
+		unwrap<SealCiphertext>(cipher).c.save(out, seal::compr_mode_type::none);
+		return (size_t)out.tellp();
+	}
+
+	size_t ciphertextMemory(const CipherPtr &cipher) const
+	{
+		return cipherMemory(unwrap<SealCiphertext>(cipher).c);
+	}
+
+	std::vector<std::pair<std::string, size_t>> keyMemory() const
+	{
+		std::vector<std::pair<std::string, size_t>> out;
+		out.push_back(std::make_pair("public", cipherMemory(public_key.data())));
+		out.push_back(std::make_pair("secret", secret_key.data().coeff_count() * sizeof(uint64_t)));
+		out.push_back(std::make_pair("relin", switchMemory(relin_keys)));
+		out.push_back(std::make_pair("galois", switchMemory(galois_keys)));
+		return out;
+	}
+
+	//Ciphertexts and temporaries come from the global pool unless told otherwise
+	size_t poolBytes() const
+	{
+		return (size_t)seal::MemoryManager::GetPool().alloc_byte_count();
+	}
+
+	void setObjectPooling(bool on)
+	{
+		ciphers.setEnabled(on);
+		plains.setEnabled(on);
+	}
+
+	PoolStats objectPool() const { return ciphers.stats() + plains.stats(); }
+
+	//CKKS has no invariant noise budget
+	int noiseBudget(const CipherPtr &cipher) const
+	{
+		if (sch != Scheme::BFV)
+			return -1;
+		needSecret();
+		return decryptor->invariant_noise_budget(unwrap<SealCiphertext>(cipher).c);
+	}
+
+	//The planner's noise model: encryption costs log2(t) + 20 bits and each
+	//product log2(t) + log2(n) + 12 more. Switching down keeps the noise
+	//relative to the modulus, so a lower level caps the budget only once it
+	//nears what a fresh ciphertext would spend there.
+	int estimateBudget(const CipherPtr &cipher, int depth) const
+	{
+		if (sch != Scheme::BFV)
+			return -1;
+		std::shared_ptr<const seal::SEALContext::ContextData> data =
+			context->get_context_data(unwrap<SealCiphertext>(cipher).c.parms_id());
+		int tb = data->parms().plain_modulus().bit_count();
+		int nb = (int)std::log2((double)data->parms().poly_modulus_degree()) + 1;
+		int fresh = tb + 20;
+		int top = context->first_context_data()->total_coeff_modulus_bit_count();
+		int here = data->total_coeff_modulus_bit_count();
+		return std::max(0, std::min(top - fresh - depth * (tb + nb + 12), here - fresh));
+	}
+
+	CipherPtr modSwitch(const CipherPtr &cipher)
+	{
+		const seal::Ciphertext &c = unwrap<SealCiphertext>(cipher).c;
+		if (!context->get_context_data(c.parms_id())->next_context_data())
+			return CipherPtr();
+		std::shared_ptr<SealCiphertext> out = ciphers.acquire(level(c) - 1);
+		HE_TRACE_SCOPE(trace, "mod-switch");
+		evaluator->mod_switch_to_next(c, out->c);
+		HE_TRACE_ONLY(traceCipher(trace, out->c));
+		return out;
+	}
+
+	//deflate needs SEAL built with zlib
+	std::vector<std::string> wireFormats() const
+	{
+		std::vector<std::string> formats = { "binary", "seeded" };
+#ifdef SEAL_USE_ZLIB
+		formats.push_back("deflate");
+		formats.push_back("seeded-deflate");
+#endif
+		return formats;
+	}
+
+	void saveCiphertext(const CipherPtr &cipher, std::ostream &out, const std::string &format) const
+	{
+		if (seededFormat(format))
+			throw std::invalid_argument(format + " ciphertexts are written by encryptTo only");
+		unwrap<SealCiphertext>(cipher).c.save(out, comprMode(format));
+	}
+
+	//Seeded ciphertexts are expanded from their seed here
+	CipherPtr loadCiphertext(std::istream &in)
+	{
+		std::shared_ptr<SealCiphertext> out = ciphers.acquire(topLevel());
+		out->c.load(context, in);
+		//results usually arrive below the top level
+		ciphers.setLevel(out, level(out->c));
+		return out;
+	}
+
+	//Seeded formats encrypt with the secret key, whose ciphertexts SEAL can save as a seed
+	void encryptTo(const PlainPtr &plain, std::ostream &out, const std::string &format)
+	{
+		if (!seededFormat(format))
+		{
+			HEBackend::encryptTo(plain, out, format);
+			return;
+		}
+		needSecret();
+		encryptor->encrypt_symmetric_save(unwrap<SealPlaintext>(plain).p, out, comprMode(format));
+	}
+
+protected:
+	seal::compr_mode_type comprMode(const std::string &format) const
+	{
+		checkFormat(*this, format);
+#ifdef SEAL_USE_ZLIB
+		if (format == "deflate" || format == "seeded-deflate")
+			return seal::compr_mode_type::deflate;
+#endif
+		return seal::compr_mode_type::none;
+	}
+
+	seal::sec_level_type securityLevel() const
+	{
+		return params.securityBits >= 256 ? seal::sec_level_type::tc256
+			: params.securityBits >= 192 ? seal::sec_level_type::tc192 : seal::sec_level_type::tc128;
+	}
+
+	void initContext(const seal::EncryptionParameters &parms)
+	{
+		context = seal::SEALContext::Create(parms, true, securityLevel());
+		evaluator.reset(new seal::Evaluator(context));
+		if (sch == Scheme::CKKS)
+			ckks_encoder.reset(new seal::CKKSEncoder(context));
+		else
+			batch_encoder.reset(new seal::BatchEncoder(context));
+		scale = std::pow(2.0, params.scaleBits);
+		//each rescale divides by a prime near the scale, so two results can
+		//drift apart by at most the primes' summed distance from it
+		scale_drift = std::ldexp(1.0, -20);
+		const std::vector<seal::SmallModulus> &chain = context->first_context_data()->parms().coeff_modulus();
+		if (sch == Scheme::CKKS)
+			for (size_t i = 1; i < chain.size(); i++)
+				scale_drift += std::fabs(std::log2((double)chain[i].value()) - params.scaleBits);
+		galois_keys = seal::GaloisKeys();
+		ciphers.clear();
+		plains.clear();
+	}
+
+	//Without a secret key (a savePublicKeys reload) only public-key encryption is set up
+	void initKeys()
+	{
+		if (!keygen)
+		{
+			encryptor.reset(new seal::Encryptor(context, public_key));
+			decryptor.reset();
+			return;
+		}
+		encryptor.reset(new seal::Encryptor(context, public_key, secret_key));
+		decryptor.reset(new seal::Decryptor(context, secret_key));
+	}
+
+	void needSecret() const
+	{
+		if (!keygen)
+			throw std::logic_error("only public keys are loaded");
+	}
+
+	static size_t cipherMemory(const seal::Ciphertext &c)
+	{
+		return c.size() * c.poly_modulus_degree() * c.coeff_mod_count() * sizeof(uint64_t);
+	}
+
+	static size_t switchMemory(const seal::KSwitchKeys &keys)
+	{
+		size_t bytes = 0;
+		for (size_t i = 0; i < keys.data().size(); i++)
+			for (size_t j = 0; j < keys.data()[i].size(); j++)
+				bytes += cipherMemory(keys.data()[i][j].data());
+		return bytes;
+	}
+
+	//Primes left to drop: 0 is the last level of the chain
+	size_t level(const seal::Ciphertext &c) const
+	{
+		return context->get_context_data(c.parms_id())->chain_index();
+	}
+
+	//Scales further apart than rescaling can drift would be off by a factor of
+	//the scale or more, so they are refused as SEAL refuses unequal ones
+	void checkScale(double have, double want) const
+	{
+		if (std::fabs(std::log2(have / want)) > scale_drift)
+			throw std::invalid_argument("scale mismatch: 2^" + std::to_string(std::log2(have)) + " against 2^" +
+				std::to_string(std::log2(want)));
+	}
+
+	size_t topLevel() const { return context->first_context_data()->chain_index(); }
+
+	//Bring both operands to the lower of their two levels: the higher one is
+	//switched into a pooled copy, xs or ys, and x or y pointed at it
+	void align(const seal::Ciphertext *&x, const seal::Ciphertext *&y, std::shared_ptr<SealCiphertext> &xs,
+		std::shared_ptr<SealCiphertext> &ys)
+	{
+		size_t lx = level(*x), ly = level(*y);
+		if (lx == ly)
+			return;
+		HE_TRACE_SCOPE(trace, "mod-switch");
+		HE_TRACE_ARG(trace, "levels", lx > ly ? lx - ly : ly - lx);
+		const seal::Ciphertext *&high = lx > ly ? x : y;
+		const seal::Ciphertext *low = lx > ly ? y : x;
+		std::shared_ptr<SealCiphertext> &copy = lx > ly ? xs : ys;
+		copy = ciphers.acquire(std::min(lx, ly));
+		evaluator->mod_switch_to(*high, low->parms_id(), copy->c);
+		high = &copy->c;
+	}
+
+	//CKKS plaintexts are encoded at the top level; one above the ciphertext's
+	//level is switched into the pooled copy
+	const seal::Plaintext *plainAt(const seal::Plaintext *p, const seal::Ciphertext &to,
+		std::shared_ptr<SealPlaintext> &copy)
+	{
+		if (p->parms_id() == to.parms_id())
+			return p;
+		HE_TRACE_SCOPE(trace, "mod-switch-plain");
+		copy = plains.acquire(level(to));
+		evaluator->mod_switch_to(*p, to.parms_id(), copy->p);
+		return &copy->p;
+	}
+
+#ifdef HE_TRACE
+	void traceCipher(TraceScope &trace, const seal::Ciphertext &c) const
+	{
+		HE_TRACE_ARG(trace, "level", level(c));
+		HE_TRACE_ARG(trace, "size", c.size());
+	}
+#endif
+
+	Scheme sch;
+	HEParams params;
+	double scale;
+	double scale_drift;   //log2 distance between scales add and addPlain realign
+	std::shared_ptr<seal::SEALContext> context;
+	std::unique_ptr<seal::KeyGenerator> keygen;
+	seal::PublicKey public_key;
+	seal::SecretKey secret_key;
+	seal::RelinKeys relin_keys;
+	seal::GaloisKeys galois_keys;
+	std::unique_ptr<seal::Encryptor> encryptor;
+	std::unique_ptr<seal::Decryptor> decryptor;
+	std::unique_ptr<seal::Evaluator> evaluator;
+	std::unique_ptr<seal::BatchEncoder> batch_encoder;
+	std::unique_ptr<seal::CKKSEncoder> ckks_encoder;
+	ObjectPool<SealCiphertext> ciphers;
+	ObjectPool<SealPlaintext> plains;
+};
+
+#endif
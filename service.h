@@ -0,0 +1,320 @@
+/***************************************/
+/* Client/server evaluation protocol   */
+/* Length-prefixed messages over a     */
+/* local Unix or TCP socket. The       */
+/* client keeps the secret key; the    */
+/* server gets the public and          */
+/* evaluation keys only, evaluates     */
+/* chunks of ciphertexts and streams   */
+/* the results back.                   */
+/*                                     */
+/*   Hello   backend, describeParams,  */
+/*           circuit, upload and       */
+/*           result wire formats       */
+/*   Keys    the savePublicKeys files  */
+/*   Chunk   id, one ciphertext per    */
+/*           circuit input, in         */
+/*           Circuit::inputs() order   */
+/*   Result  id, the output ciphertext */
+/*   End     client: no more chunks;   */
+/*           server: all answered      */
+/*   Error   message text              */
+/*                                     */
+/* Hello and Keys are acknowledged     */
+/* with an empty message of the same   */
+/* type. Results come back in          */
+/* completion order.                   */
+/***************************************/
+#ifndef SERVICE_H
+#define SERVICE_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <utility>
+#include "dataset.h"
+
+enum class Message : uint32_t { Hello = 1, Keys, Chunk, Result, End, Error };
+
+struct MessageHeader
+{
+	uint32_t type;
+	uint32_t reserved;
+	uint64_t length;
+};
+
+//Default cap on one message's payload, just above the largest key upload
+//these programs produce (every power-of-two rotation key at ring 32768 is
+//about 3.6 GB), so a corrupt header or a stray client on the port is
+//refused before anything is allocated
+const uint64_t DefaultMaxPayload = 4ull << 30;
+
+//"unix:PATH" or "tcp:PORT" (loopback only); listening on a Unix path
+//replaces whatever socket file is there
+inline int openSocket(const std::string &address, bool listening)
+{
+	bool unix_socket = address.compare(0, 5, "unix:") == 0;
+	if (!unix_socket && address.compare(0, 4, "tcp:") != 0)
+		throw std::invalid_argument("socket address must be unix:PATH or tcp:PORT, not " + address);
+
+	int fd = socket(unix_socket ? AF_UNIX : AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		throw std::runtime_error("socket: " + std::string(std::strerror(errno)));
+
+	sockaddr_un un;
+	sockaddr_in in;
+	sockaddr *addr;
+	socklen_t len;
+	if (unix_socket)
+	{
+		std::string path = address.substr(5);
+		std::memset(&un, 0, sizeof(un));
+		un.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(un.sun_path))
+			throw std::invalid_argument("socket path too long: " + path);
+		std::memcpy(un.sun_path, path.data(), path.size());
+		if (listening)
+			unlink(path.c_str());
+		addr = (sockaddr *)&un;
+		len = sizeof(un);
+	}
+	else
+	{
+		std::memset(&in, 0, sizeof(in));
+		in.sin_family = AF_INET;
+		in.sin_port = htons((uint16_t)std::atoi(address.c_str() + 4));
+		in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr = (sockaddr *)&in;
+		len = sizeof(in);
+		int on = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	}
+
+	int rc = listening ? bind(fd, addr, len) : connect(fd, addr, len);
+	if (rc == 0 && listening)
+		rc = listen(fd, 4);
+	if (rc != 0)
+	{
+		std::string err = std::strerror(errno);
+		close(fd);
+		throw std::runtime_error((listening ? "cannot listen on " : "cannot connect to ") + address + ": " + err);
+	}
+	return fd;
+}
+
+//One connected socket. send may be called from several threads at once;
+//receive from one thread only.
+class Connection
+{
+public:
+	explicit Connection(int fd, uint64_t maxPayload = DefaultMaxPayload)
+		: fd(fd), max_payload(maxPayload), sent_bytes(0), received_bytes(0), error_sent(false)
+	{
+		//messages are written whole, so do not wait to coalesce them
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	}
+
+	~Connection() { close(fd); }
+
+	Connection(const Connection &) = delete;
+	Connection &operator=(const Connection &) = delete;
+
+	void send(Message type, const std::string &payload)
+	{
+		MessageHeader h = { (uint32_t)type, 0, payload.size() };
+		std::lock_guard<std::mutex> lock(send_mutex);
+		writeAll((const char *)&h, sizeof(h));
+		writeAll(payload.data(), payload.size());
+		sent_bytes += sizeof(h) + payload.size();
+	}
+
+	//The Error message for a failed session, sent at most once however many
+	//threads report the failure; a broken connection is ignored
+	void sendError(const std::string &text)
+	{
+		if (error_sent.exchange(true))
+			return;
+		try
+		{
+			send(Message::Error, text);
+		}
+		catch (const std::exception &)
+		{
+		}
+	}
+
+	//false when the peer closed the connection between messages. A header
+	//with an unknown type or a length over the cap is answered with Error
+	//and throws; the rest of the stream cannot be trusted after it.
+	bool receive(Message &type, std::string &payload)
+	{
+		MessageHeader h;
+		if (!readAll((char *)&h, sizeof(h), true))
+			return false;
+		std::string bad;
+		if (h.type < (uint32_t)Message::Hello || h.type > (uint32_t)Message::Error)
+			bad = "unknown message type " + std::to_string(h.type);
+		else if (h.length > max_payload)
+			bad = "message of " + std::to_string(h.length) + " bytes exceeds the limit of " +
+				std::to_string(max_payload);
+		if (!bad.empty())
+		{
+			sendError(bad);
+			throw std::runtime_error(bad);
+		}
+		type = (Message)h.type;
+		payload.resize(h.length);
+		readAll(&payload[0], payload.size(), false);
+		received_bytes += sizeof(h) + payload.size();
+		return true;
+	}
+
+	//Receive a message that must be of the given type; Error messages throw
+	std::string expect(Message type)
+	{
+		Message got;
+		std::string payload;
+		if (!receive(got, payload))
+			throw std::runtime_error("connection closed");
+		if (got == Message::Error)
+			throw std::runtime_error("peer: " + payload);
+		if (got != type)
+			throw std::runtime_error("unexpected message " + std::to_string((uint32_t)got));
+		return payload;
+	}
+
+	//Bytes on the wire, headers included
+	uint64_t sent() const { return sent_bytes; }
+	uint64_t received() const { return received_bytes; }
+
+private:
+	void writeAll(const char *p, size_t n)
+	{
+		while (n > 0)
+		{
+			ssize_t k = ::send(fd, p, n, MSG_NOSIGNAL);
+			if (k < 0 && errno == EINTR)
+				continue;
+			if (k <= 0)
+				throw std::runtime_error("send: " + std::string(std::strerror(errno)));
+			p += k;
+			n -= (size_t)k;
+		}
+	}
+
+	bool readAll(char *p, size_t n, bool eofOk)
+	{
+		size_t done = 0;
+		while (done < n)
+		{
+			ssize_t k = ::recv(fd, p + done, n - done, 0);
+			if (k < 0 && errno == EINTR)
+				continue;
+			if (k == 0 && done == 0 && eofOk)
+				return false;
+			if (k <= 0)
+				throw std::runtime_error(k == 0 ? "connection closed mid-message"
+												: "recv: " + std::string(std::strerror(errno)));
+			done += (size_t)k;
+		}
+		return true;
+	}
+
+	int fd;
+	uint64_t max_payload;
+	std::mutex send_mutex;
+	std::atomic<uint64_t> sent_bytes, received_bytes;
+	std::atomic<bool> error_sent;
+};
+
+//Fields of a payload written with writeU64/writeString
+class PayloadReader
+{
+public:
+	explicit PayloadReader(std::string payload) : data(std::move(payload)), pos(0) {}
+
+	uint64_t u64()
+	{
+		uint64_t v;
+		std::memcpy(&v, take(sizeof(v)), sizeof(v));
+		return v;
+	}
+
+	std::string str()
+	{
+		uint32_t n;
+		std::memcpy(&n, take(sizeof(n)), sizeof(n));
+		return std::string(take(n), n);
+	}
+
+private:
+	const char *take(size_t n)
+	{
+		if (pos + n > data.size())
+			throw std::runtime_error("truncated message");
+		const char *p = data.data() + pos;
+		pos += n;
+		return p;
+	}
+
+	std::string data;
+	size_t pos;
+};
+
+//A fresh private directory under the system temporary directory
+inline std::string makeTempDir(const std::string &prefix)
+{
+	std::string path = (std::filesystem::temp_directory_path() / (prefix + "-XXXXXX")).string();
+	if (!mkdtemp(&path[0]))
+		throw std::runtime_error("cannot create a temporary directory for " + prefix);
+	return path;
+}
+
+//The regular files of a key directory as one payload, and back
+inline std::string packDirectory(const std::string &dir)
+{
+	std::ostringstream out;
+	std::vector<std::filesystem::path> files;
+	for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(dir))
+		if (entry.is_regular_file())
+			files.push_back(entry.path());
+	writeU64(out, files.size());
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		std::ifstream in(files[i], std::ios::binary);
+		writeString(out, files[i].filename().string());
+		writeString(out, std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()));
+	}
+	return out.str();
+}
+
+inline void unpackDirectory(const std::string &payload, const std::string &dir)
+{
+	PayloadReader in(payload);
+	uint64_t files = in.u64();
+	for (uint64_t i = 0; i < files; i++)
+	{
+		std::string name = in.str();
+		if (name.empty() || name.find('/') != std::string::npos || name[0] == '.')
+			throw std::runtime_error("bad key file name " + name);
+		std::string bytes = in.str();
+		std::ofstream(dir + "/" + name, std::ios::binary).write(bytes.data(), bytes.size());
+	}
+}
+
+#endif
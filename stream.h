@@ -0,0 +1,241 @@
+/***************************************/
+/* Streaming evaluation                */
+/* Splits arbitrarily long x/y/z       */
+/* columns into slot-sized chunks and  */
+/* runs encode->encrypt->evaluate->    */
+/* decrypt as a bounded two-stage      */
+/* pipeline: at most `inflight` chunks */
+/* exist at once, so memory does not   */
+/* grow with the input.                */
+/***************************************/
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cmath>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "datagen.h"
+#include "he_backend.h"
+#include "workload.h"
+
+//Column input read chunk by chunk
+class ColumnSource
+{
+public:
+	virtual ~ColumnSource() {}
+	virtual size_t rows() const = 0;
+	//Fill chunk with up to maxRows rows; returns the number read, 0 at the end
+	virtual size_t read(size_t maxRows, Columns &chunk) = 0;
+};
+
+//The rows makeColumns would give, generated chunk by chunk
+class GeneratedSource : public ColumnSource
+{
+public:
+	GeneratedSource(size_t rows, unsigned long seed, bool integer)
+		: total(rows), done(0), seed(seed), integer(integer)
+	{
+	}
+
+	size_t rows() const { return total; }
+
+	size_t read(size_t maxRows, Columns &chunk)
+	{
+		size_t n = std::min(maxRows, total - done);
+		chunk.x.resize(n);
+		chunk.y.resize(n);
+		chunk.z.resize(n);
+		fillColumn(chunk.x.data(), n, done, seed, ColumnX, integer);
+		fillColumn(chunk.y.data(), n, done, seed, ColumnY, integer);
+		fillColumn(chunk.z.data(), n, done, seed, ColumnZ, integer);
+		done += n;
+		return n;
+	}
+
+private:
+	size_t total;
+	size_t done;
+	unsigned long seed;
+	bool integer;
+};
+
+//Fixed-capacity FIFO; push blocks while full, pop blocks while empty.
+//After close, pop drains what is left and push is refused.
+template <class T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity) : capacity(capacity ? capacity : 1), closed(false) {}
+
+	//false if the queue was closed while waiting
+	bool push(T item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		not_full.wait(lock, [this] { return items.size() < capacity || closed; });
+		if (closed)
+			return false;
+		items.push_back(std::move(item));
+		not_empty.notify_one();
+		return true;
+	}
+
+	bool pop(T &item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		not_empty.wait(lock, [this] { return !items.empty() || closed; });
+		if (items.empty())
+			return false;
+		item = std::move(items.front());
+		items.pop_front();
+		not_full.notify_one();
+		return true;
+	}
+
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		not_empty.notify_all();
+		not_full.notify_all();
+	}
+
+private:
+	size_t capacity;
+	bool closed;
+	std::deque<T> items;
+	std::mutex mutex;
+	std::condition_variable not_full;
+	std::condition_variable not_empty;
+};
+
+struct StreamStats
+{
+	size_t rows;
+	size_t chunks;
+	double wall;                                    //seconds for the whole stream
+	double encode, encrypt, eval, decrypt, decode;  //seconds summed over chunks
+
+	StreamStats() : rows(0), chunks(0), wall(0), encode(0), encrypt(0), eval(0), decrypt(0), decode(0) {}
+
+	double rowsPerSec() const { return wall > 0 ? rows / wall : 0; }
+
+	void report(std::ostream &out) const
+	{
+		out << "Streamed " << rows << " rows in " << chunks << " chunks, " << wall << " s, "
+			<< rowsPerSec() << " rows/s" << std::endl;
+		out << "  stage seconds: encode " << encode << ", encrypt " << encrypt << ", eval " << eval
+			<< ", decrypt " << decrypt << ", decode " << decode << std::endl;
+	}
+};
+
+//Called on the consumer thread for each finished chunk, in input order
+typedef std::function<void(size_t offset, const Columns &in, const std::vector<double> &e)> ChunkSink;
+
+//Stream src through y(x+z). The context and keys must already exist.
+//The reader thread encodes and encrypts while the calling thread evaluates
+//and decrypts, so the adapter is used from two threads at once; the reader
+//takes the caller's library thread count.
+inline StreamStats runStream(HEBackend &he, ColumnSource &src, size_t inflight, const ChunkSink &sink)
+{
+	struct Chunk
+	{
+		size_t offset;
+		Columns in;
+		CipherPtr x, y, z;
+	};
+
+	typedef std::chrono::steady_clock clk;
+	StreamStats stats;
+	BoundedQueue<Chunk> queue(inflight);
+	size_t slots = he.slotCount();
+	double encode = 0, encrypt = 0;
+	std::exception_ptr failed;
+	size_t lib_threads = he.threads();
+
+	clk::time_point begin = clk::now();
+	std::thread reader([&] {
+		he.setThreads(lib_threads);
+		size_t offset = 0;
+		try
+		{
+			for (;;)
+			{
+				Chunk c;
+				c.offset = offset;
+				size_t n = src.read(slots, c.in);
+				if (n == 0)
+					break;
+
+				clk::time_point t0 = clk::now();
+				PlainPtr px = he.encode(c.in.x);
+				PlainPtr py = he.encode(c.in.y);
+				PlainPtr pz = he.encode(c.in.z);
+				clk::time_point t1 = clk::now();
+				c.x = he.encrypt(px);
+				c.y = he.encrypt(py);
+				c.z = he.encrypt(pz);
+				clk::time_point t2 = clk::now();
+
+				encode += std::chrono::duration<double>(t1 - t0).count();
+				encrypt += std::chrono::duration<double>(t2 - t1).count();
+				offset += n;
+				if (!queue.push(std::move(c)))
+					break;
+			}
+		}
+		catch (...)
+		{
+			failed = std::current_exception();
+		}
+		queue.close();
+	});
+
+	try
+	{
+		Chunk c;
+		while (queue.pop(c))
+		{
+			clk::time_point t0 = clk::now();
+			CipherPtr e = evalYXZ(he, c.x, c.y, c.z);
+			clk::time_point t1 = clk::now();
+			PlainPtr pe = he.decrypt(e);
+			clk::time_point t2 = clk::now();
+			std::vector<double> out = he.decode(pe);
+			clk::time_point t3 = clk::now();
+
+			stats.eval += std::chrono::duration<double>(t1 - t0).count();
+			stats.decrypt += std::chrono::duration<double>(t2 - t1).count();
+			stats.decode += std::chrono::duration<double>(t3 - t2).count();
+
+			out.resize(c.in.x.size());
+			stats.rows += out.size();
+			stats.chunks++;
+			if (sink)
+				sink(c.offset, c.in, out);
+		}
+	}
+	catch (...)
+	{
+		//unblock the reader before leaving
+		queue.close();
+		reader.join();
+		throw;
+	}
+	reader.join();
+	if (failed)
+		std::rethrow_exception(failed);
+
+	stats.wall = std::chrono::duration<double>(clk::now() - begin).count();
+	stats.encode = encode;
+	stats.encrypt = encrypt;
+	return stats;
+}
+
+#endif
@@ -0,0 +1,191 @@
+/***************************************/
+/* Work-stealing thread pool           */
+/* Each worker owns a deque: it pops   */
+/* its own tasks LIFO and steals other */
+/* workers' oldest tasks when idle.    */
+/***************************************/
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	explicit ThreadPool(size_t threads = std::thread::hardware_concurrency())
+		: pending(0), next_queue(0), stopping(false)
+	{
+		if (threads == 0)
+			threads = 1;
+		for (size_t i = 0; i < threads; i++)
+			queues.push_back(std::unique_ptr<Queue>(new Queue));
+		for (size_t i = 0; i < threads; i++)
+			workers.push_back(std::thread([this, i] { work(i); }));
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+	}
+
+	size_t size() const { return workers.size(); }
+
+	template <class F>
+	auto submit(F f) -> std::future<decltype(f())>
+	{
+		typedef decltype(f()) R;
+		std::shared_ptr<std::packaged_task<R()>> task(new std::packaged_task<R()>(f));
+		std::future<R> result = task->get_future();
+		push([task] { (*task)(); });
+		return result;
+	}
+
+	//Queue a task without a future; it must not throw
+	void post(std::function<void()> task) { push(std::move(task)); }
+
+	//Run f(0..n-1) on the pool and wait. A pool worker calling this keeps
+	//running tasks while it waits, so nested loops cannot deadlock.
+	template <class F>
+	void parallelFor(size_t n, F f)
+	{
+		if (n == 0)
+			return;
+
+		std::atomic<size_t> remaining(n);
+		std::exception_ptr failed;
+		std::mutex done_mutex;
+		std::condition_variable done;
+		for (size_t i = 0; i < n; i++)
+		{
+			push([&, i] {
+				try
+				{
+					f(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(done_mutex);
+					if (!failed)
+						failed = std::current_exception();
+				}
+				//decrement under the lock so the waiter cannot return while we still touch its locals
+				std::lock_guard<std::mutex> lock(done_mutex);
+				if (--remaining == 0)
+					done.notify_all();
+			});
+		}
+
+		int self = current();
+		if (self < 0)
+		{
+			std::unique_lock<std::mutex> lock(done_mutex);
+			done.wait(lock, [&] { return remaining == 0; });
+		}
+		while (remaining > 0)
+		{
+			if (!runOne((size_t)self))
+				std::this_thread::yield();
+		}
+		std::lock_guard<std::mutex> lock(done_mutex);
+		if (failed)
+			std::rethrow_exception(failed);
+	}
+
+private:
+	struct Queue
+	{
+		std::deque<std::function<void()>> tasks;
+		std::mutex mutex;
+	};
+
+	//Index of the calling worker, -1 outside the pool
+	static int &current()
+	{
+		static thread_local int index = -1;
+		return index;
+	}
+
+	void push(std::function<void()> task)
+	{
+		int self = current();
+		size_t q = self >= 0 ? (size_t)self : next_queue++ % queues.size();
+		{
+			std::lock_guard<std::mutex> lock(queues[q]->mutex);
+			queues[q]->tasks.push_back(std::move(task));
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			pending++;
+		}
+		wake.notify_one();
+	}
+
+	//Own queue newest first, then the oldest task of any other queue
+	bool runOne(size_t self)
+	{
+		std::function<void()> task;
+		for (size_t k = 0; k < queues.size() && !task; k++)
+		{
+			Queue &q = *queues[(self + k) % queues.size()];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if (q.tasks.empty())
+				continue;
+			if (k == 0)
+			{
+				task = std::move(q.tasks.back());
+				q.tasks.pop_back();
+			}
+			else
+			{
+				task = std::move(q.tasks.front());
+				q.tasks.pop_front();
+			}
+		}
+		if (!task)
+			return false;
+
+		pending--;
+		task();
+		return true;
+	}
+
+	void work(size_t self)
+	{
+		current() = (int)self;
+		for (;;)
+		{
+			if (runOne(self))
+				continue;
+
+			std::unique_lock<std::mutex> lock(sleep_mutex);
+			wake.wait(lock, [this] { return stopping || pending > 0; });
+			if (stopping && pending == 0)
+				return;
+		}
+	}
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<size_t> pending;
+	std::atomic<size_t> next_queue;
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	bool stopping;
+};
+
+#endif
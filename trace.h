@@ -0,0 +1,238 @@
+/***************************************/
+/* Operation trace                     */
+/* Scoped spans around each library    */
+/* call, with the thread and the       */
+/* ciphertext's level and size, saved  */
+/* as Chrome trace-event JSON for      */
+/* chrome://tracing or Perfetto.       */
+/* Built with HE_TRACE only; otherwise */
+/* every HE_TRACE_* macro expands to   */
+/* nothing.                            */
+/***************************************/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+
+#ifdef HE_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//One complete ("X") event; times in nanoseconds since the log was created
+struct TraceEvent
+{
+	std::string name;
+	const char *category;
+	int64_t start, duration;
+	int args;
+	const char *keys[4];
+	long long values[4];
+};
+
+class TraceLog
+{
+public:
+	static TraceLog &global()
+	{
+		static TraceLog log;
+		return log;
+	}
+
+	//Start recording; the file is rewritten by every flush
+	void open(const std::string &file)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		path = file;
+		recording.store(true, std::memory_order_relaxed);
+	}
+
+	bool on() const { return recording.load(std::memory_order_relaxed); }
+
+	int64_t now() const { return toNanos(std::chrono::steady_clock::now()); }
+
+	int64_t toNanos(std::chrono::steady_clock::time_point t) const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(t - epoch).count();
+	}
+
+	//Appends to the calling thread's own buffer; its lock is only ever
+	//contended by a flush
+	void add(const TraceEvent &e)
+	{
+		Buffer &b = buffer();
+		std::lock_guard<std::mutex> lock(b.mutex);
+		b.events.push_back(e);
+	}
+
+	void flush()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (path.empty())
+			return;
+		std::ofstream out(path.c_str());
+		out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		bool first = true;
+		for (size_t t = 0; t < buffers.size(); t++)
+		{
+			Buffer &b = *buffers[t];
+			std::lock_guard<std::mutex> events_lock(b.mutex);
+			out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b.tid
+				<< ",\"args\":{\"name\":\"thread " << b.tid << "\"}}";
+			first = false;
+			for (size_t i = 0; i < b.events.size(); i++)
+				write(out, b.events[i], b.tid);
+		}
+		out << "\n]}\n";
+	}
+
+private:
+	struct Buffer
+	{
+		std::mutex mutex;
+		std::vector<TraceEvent> events;
+		int tid;
+	};
+
+	TraceLog() : recording(false), epoch(std::chrono::steady_clock::now()) {}
+
+	//Buffers live as long as the log, so a flush may read those of threads
+	//that have already exited
+	Buffer &buffer()
+	{
+		thread_local Buffer *mine = 0;
+		if (!mine)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			buffers.push_back(std::unique_ptr<Buffer>(new Buffer));
+			mine = buffers.back().get();
+			mine->tid = (int)buffers.size() - 1;
+			mine->events.reserve(4096);
+		}
+		return *mine;
+	}
+
+	static void write(std::ostream &out, const TraceEvent &e, int tid)
+	{
+		char times[64];
+		std::snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", e.start / 1e3, e.duration / 1e3);
+		out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+			<< tid << "," << times;
+		if (e.args)
+		{
+			out << ",\"args\":{";
+			for (int i = 0; i < e.args; i++)
+				out << (i ? "," : "") << "\"" << e.keys[i] << "\":" << e.values[i];
+			out << "}";
+		}
+		out << "}";
+	}
+
+	std::atomic<bool> recording;
+	std::chrono::steady_clock::time_point epoch;
+	std::mutex mutex;
+	std::string path;
+	std::vector<std::unique_ptr<Buffer>> buffers;
+};
+
+//Records one event from construction to destruction while the log is on
+class TraceScope
+{
+public:
+	explicit TraceScope(const char *name, const char *category = "he")
+		: name(name), category(category), start(TraceLog::global().on() ? TraceLog::global().now() : -1), args(0)
+	{
+	}
+
+	~TraceScope()
+	{
+		if (!active())
+			return;
+		TraceEvent e;
+		e.name = name;
+		e.category = category;
+		e.start = start;
+		e.duration = TraceLog::global().now() - start;
+		e.args = args;
+		for (int i = 0; i < args; i++)
+		{
+			e.keys[i] = keys[i];
+			e.values[i] = values[i];
+		}
+		TraceLog::global().add(e);
+	}
+
+	bool active() const { return start >= 0; }
+
+	//Up to four integer arguments shown with the event
+	void arg(const char *key, long long value)
+	{
+		if (args == 4)
+			return;
+		keys[args] = key;
+		values[args++] = value;
+	}
+
+private:
+	TraceScope(const TraceScope &);
+	TraceScope &operator=(const TraceScope &);
+
+	const char *name;
+	const char *category;
+	int64_t start;
+	int args;
+	const char *keys[4];
+	long long values[4];
+};
+
+//A span timed elsewhere, e.g. a Benchmark phase
+inline void traceSpan(const std::string &name, const char *category, std::chrono::steady_clock::time_point begin,
+	std::chrono::steady_clock::time_point end)
+{
+	TraceLog &log = TraceLog::global();
+	if (!log.on())
+		return;
+	TraceEvent e;
+	e.name = name;
+	e.category = category;
+	e.start = log.toNanos(begin);
+	e.duration = log.toNanos(end) - e.start;
+	e.args = 0;
+	log.add(e);
+}
+
+inline void traceOpen(const std::string &path) { TraceLog::global().open(path); }
+inline void traceFlush() { TraceLog::global().flush(); }
+const bool TraceBuilt = true;
+
+//The value expression of HE_TRACE_ARG is evaluated only while recording
+#define HE_TRACE_SCOPE(var, name) TraceScope var(name)
+#define HE_TRACE_ARG(var, key, value) \
+	do \
+	{ \
+		if (var.active()) \
+			var.arg(key, (long long)(value)); \
+	} while (0)
+#define HE_TRACE_SPAN(name, category, begin, end) traceSpan(name, category, begin, end)
+#define HE_TRACE_ONLY(statement) statement
+
+#else
+
+inline void traceOpen(const std::string &) {}
+inline void traceFlush() {}
+const bool TraceBuilt = false;
+
+#define HE_TRACE_SCOPE(var, name) ((void)0)
+#define HE_TRACE_ARG(var, key, value) ((void)0)
+#define HE_TRACE_SPAN(name, category, begin, end) ((void)0)
+#define HE_TRACE_ONLY(statement) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,148 @@
+/***************************************/
+/* Workloads written once against      */
+/* HEBackend: e = y(x+z) over x/y/z    */
+/* columns, with the same data and     */
+/* circuit on every backend.           */
+/***************************************/
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <cmath>
+#include <vector>
+#include "benchmark.h"
+#include "datagen.h"
+#include "he_backend.h"
+#include "key_cache.h"
+#include "keys.h"
+
+struct Columns
+{
+	std::vector<double> x, y, z;
+};
+
+//x/y/z from datagen.h: the same rows for a given seed at any n
+inline Columns makeColumns(size_t n, unsigned long seed, bool integer)
+{
+	Columns cols;
+	cols.x.resize(n);
+	cols.y.resize(n);
+	cols.z.resize(n);
+	fillColumn(cols.x.data(), n, 0, seed, ColumnX, integer);
+	fillColumn(cols.y.data(), n, 0, seed, ColumnY, integer);
+	fillColumn(cols.z.data(), n, 0, seed, ColumnZ, integer);
+	return cols;
+}
+
+//Plaintext reference for y(x+z)
+inline std::vector<double> referenceYXZ(const Columns &cols)
+{
+	std::vector<double> e(cols.x.size());
+	for (size_t i = 0; i < e.size(); i++)
+		e[i] = cols.y[i] * (cols.x[i] + cols.z[i]);
+	return e;
+}
+
+//e = y(x+z): one add, one multiply, relinearize, then rescale/mod-switch
+inline CipherPtr evalYXZ(HEBackend &he, const CipherPtr &x, const CipherPtr &y, const CipherPtr &z)
+{
+	CipherPtr sum = he.add(x, z);
+	CipherPtr e = he.multiply(y, sum);
+	he.relinearize(e);
+	he.rescale(e);
+	return e;
+}
+
+//Evaluation keys y(x+z) needs on he (whose context must exist)
+inline KeyRequirements yxzKeys(const HEBackend &he)
+{
+	return analyzeKeys(he, [](HEBackend &probe) {
+		PlainPtr p = probe.encode(std::vector<double>());
+		evalYXZ(probe, probe.encrypt(p), probe.encrypt(p), probe.encrypt(p));
+	});
+}
+
+//Largest absolute difference between the decrypted result and the reference
+inline double maxError(const std::vector<double> &got, const std::vector<double> &want)
+{
+	double err = 0;
+	for (size_t i = 0; i < want.size(); i++)
+	{
+		double d = std::fabs((i < got.size() ? got[i] : 0) - want[i]);
+		if (d > err)
+			err = d;
+	}
+	return err;
+}
+
+//Context and keys through the cache, timed as startup-cold or startup-warm
+inline void timedStartup(HEBackend &he, const HEParams &params, KeyCache &cache, Benchmark &bench)
+{
+	Stopwatch sw;
+	bool warm = cache.setup(he, params, [&] { return yxzKeys(he); });
+	bench.record(warm ? "startup-warm" : "startup-cold", sw.elapsed());
+}
+
+//Key and ciphertext sizes, reported with the phase timings
+inline void recordSizes(HEBackend &he, const CipherPtr &fresh, const CipherPtr &result, Benchmark &bench)
+{
+	std::vector<std::pair<std::string, size_t>> keys = he.keyMemory();
+	for (size_t i = 0; i < keys.size(); i++)
+		bench.objectSize("key " + keys[i].first, keys[i].second);
+	bench.objectSize("ciphertext fresh", he.ciphertextMemory(fresh));
+	bench.objectSize("ciphertext result", he.ciphertextMemory(result));
+}
+
+//One full run of y(x+z) with every phase timed in bench; returns the decoded result.
+//With a cache the context and keys come from disk when possible.
+inline std::vector<double> runYXZ(HEBackend &he, const HEParams &params, const Columns &cols, Benchmark &bench,
+	KeyCache *cache = 0)
+{
+	bench.poolProbe([&he] { return he.poolBytes(); });
+	if (cache)
+	{
+		timedStartup(he, params, *cache, bench);
+	}
+	else
+	{
+		bench.start("context");
+		he.createContext(params);
+		bench.stop("context");
+
+		KeyRequirements keys = yxzKeys(he);
+		bench.start("keygen");
+		generateKeys(he, keys);
+		bench.stop("keygen");
+	}
+
+	bench.start("encode");
+	PlainPtr px = he.encode(cols.x);
+	PlainPtr py = he.encode(cols.y);
+	PlainPtr pz = he.encode(cols.z);
+	bench.stop("encode");
+
+	bench.start("encrypt");
+	CipherPtr cx = he.encrypt(px);
+	CipherPtr cy = he.encrypt(py);
+	CipherPtr cz = he.encrypt(pz);
+	bench.stop("encrypt");
+
+	bench.start("eval");
+	CipherPtr ce = evalYXZ(he, cx, cy, cz);
+	bench.stop("eval");
+
+	bench.start("decrypt");
+	PlainPtr pe = he.decrypt(ce);
+	bench.stop("decrypt");
+
+	bench.start("decode");
+	std::vector<double> e = he.decode(pe);
+	bench.stop("decode");
+
+	if (bench.last())
+		recordSizes(he, cx, ce, bench);
+
+	e.resize(cols.x.size());
+	return e;
+}
+
+#endif